@@ -0,0 +1,189 @@
+#include "fbigint.hpp"
+#include <chrono>
+#include <climits>
+#include <iomanip>
+#include <iostream>
+
+// Average time in microseconds of a * b, repeated until at least ~50ms have been spent
+static double timeMultiply(const BigInt &a, const BigInt &b)
+{
+  int iterations = 0;
+  BigInt sink;
+  auto start = std::chrono::steady_clock::now();
+  double elapsed = 0;
+  do {
+    sink = a * b;
+    iterations++;
+    elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  } while (elapsed < 50000);
+  return elapsed / iterations;
+}
+
+// Times each multiplication tier on its own: schoolbook only, Karatsuba over schoolbook,
+// Toom-3 over Karatsuba and NTT, so the crossover points for the thresholds can be read off
+void benchmarkMultiply()
+{
+  size_t karatsuba = BigInt::karatsubaThreshold();
+  size_t toom3 = BigInt::toom3Threshold();
+  size_t ntt = BigInt::nttThreshold();
+
+  std::cout << "Multiplication, microseconds per product" << std::endl;
+  std::cout << std::setw(10) << "bits" << std::setw(14) << "schoolbook" << std::setw(14) << "karatsuba"
+            << std::setw(14) << "toom3" << std::setw(14) << "ntt" << std::endl;
+
+  int sizes[] = {1024, 2048, 4096, 8192, 16384, 32768, 65536, 131072, 262144, 524288, 1048576};
+  for (int bits : sizes) {
+    BigInt a = BigInt::generateRandom(bits);
+    BigInt b = BigInt::generateRandom(bits);
+
+    BigInt::karatsubaThreshold() = SIZE_MAX;
+    BigInt::toom3Threshold() = SIZE_MAX;
+    BigInt::nttThreshold() = SIZE_MAX;
+    double schoolbook = bits <= 131072 ? timeMultiply(a, b) : 0;
+
+    BigInt::karatsubaThreshold() = karatsuba;
+    double kara = timeMultiply(a, b);
+
+    BigInt::toom3Threshold() = 3 * karatsuba;
+    double toom = timeMultiply(a, b);
+    BigInt::toom3Threshold() = toom3;
+
+    BigInt::nttThreshold() = 1;
+    double transform = timeMultiply(a, b);
+    BigInt::nttThreshold() = ntt;
+
+    std::cout << std::setw(10) << bits << std::fixed << std::setprecision(1)
+              << std::setw(14) << schoolbook << std::setw(14) << kara << std::setw(14) << toom
+              << std::setw(14) << transform << std::endl;
+  }
+}
+
+// Unbalanced products with a Toom-sized shorter operand, Karatsuba blocks against the
+// default dispatch that cuts the longer operand into blocks for Toom-3
+void benchmarkUnbalancedMultiply()
+{
+  size_t toom3 = BigInt::toom3Threshold();
+
+  std::cout << "Unbalanced multiplication by 1600 limbs, microseconds per product" << std::endl;
+  std::cout << std::setw(10) << "limbs" << std::setw(14) << "karatsuba" << std::setw(14) << "toom3" << std::endl;
+
+  int sizes[] = {4000, 20000, 60000, 150000};
+  BigInt b = BigInt::generateRandom(1600 * 64);
+  for (int limbs : sizes) {
+    BigInt a = BigInt::generateRandom(limbs * 64);
+
+    BigInt::toom3Threshold() = SIZE_MAX;
+    double kara = timeMultiply(a, b);
+    BigInt::toom3Threshold() = toom3;
+    double toom = timeMultiply(a, b);
+
+    std::cout << std::setw(10) << limbs << std::fixed << std::setprecision(1)
+              << std::setw(14) << kara << std::setw(14) << toom << std::endl;
+  }
+}
+
+// Scratch size and heap allocations of one Karatsuba product, which stay fixed per product
+// however deep the recursion goes
+void benchmarkKaratsubaMemory()
+{
+  std::cout << "Karatsuba memory per product" << std::endl;
+  std::cout << std::setw(10) << "bits" << std::setw(16) << "scratch limbs" << std::setw(14) << "allocations" << std::endl;
+
+  int sizes[] = {4096, 16384, 65536, 262144, 1048576};
+  for (int bits : sizes) {
+    BigInt a = BigInt::generateRandom(bits);
+    BigInt b = BigInt::generateRandom(bits);
+    unsigned long long before = BigInt::allocationCount();
+    BigInt product = a.karatsubaMultiply(b);
+    unsigned long long allocations = BigInt::allocationCount() - before;
+
+    size_t limbs = bits / BigInt::LIMB_BITS;
+    std::cout << std::setw(10) << bits << std::setw(16) << BigInt::karatsubaScratchSize(limbs, limbs)
+              << std::setw(14) << allocations << std::endl;
+  }
+}
+
+// One large product at 1 to 8 threads, with the speedup over the serial product. The
+// threaded results are checked against the serial one, they must be bit-identical.
+void benchmarkParallelMultiply()
+{
+  std::cout << "Threaded multiplication, milliseconds per product (speedup)" << std::endl;
+  std::cout << std::setw(10) << "bits" << std::setw(16) << "1" << std::setw(16) << "2" << std::setw(16) << "4"
+            << std::setw(16) << "8" << std::endl;
+
+  int sizes[] = {131072, 524288, 2097152, 8388608};
+  for (int bits : sizes) {
+    BigInt a = BigInt::generateRandom(bits);
+    BigInt b = BigInt::generateRandom(bits);
+    BigInt serial = a * b;
+    double base = 0;
+    std::cout << std::setw(10) << bits;
+    for (unsigned threads = 1; threads <= 8; threads *= 2) {
+      BigInt::multiplyThreads() = threads;
+      double ms = timeMultiply(a, b) / 1000;
+      if (threads == 1) {
+        base = ms;
+      }
+      bool identical = a * b == serial;
+      std::cout << std::setw(9) << std::fixed << std::setprecision(1) << ms << " (" << std::setprecision(2)
+                << base / ms << (identical ? ")" : "!)");
+    }
+    BigInt::multiplyThreads() = 1;
+    std::cout << std::endl;
+  }
+}
+
+// Latency of confirming a probable prime with 20 Miller-Rabin rounds on 1 to 8 threads
+void benchmarkIsPrime()
+{
+  std::cout << "isPrime(20, threads) on Mersenne primes, milliseconds" << std::endl;
+  std::cout << std::setw(10) << "bits" << std::setw(10) << "1" << std::setw(10) << "2" << std::setw(10) << "4"
+            << std::setw(10) << "8" << std::endl;
+
+  int exponents[] = {2203, 4253};
+  for (int p : exponents) {
+    BigInt prime = (BigInt(1) << p) - 1;
+    std::cout << std::setw(10) << p;
+    for (unsigned threads = 1; threads <= 8; threads *= 2) {
+      auto start = std::chrono::steady_clock::now();
+      bool result = prime.isPrime(20, threads);
+      double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      std::cout << std::setw(10) << std::fixed << std::setprecision(1) << (result ? ms : -1.0);
+    }
+    std::cout << std::endl;
+  }
+}
+
+// Average time of generatePrime with either test, the sieve leaves the test only a few
+// candidates per prime
+void benchmarkGeneratePrime()
+{
+  std::cout << "generatePrime, milliseconds per prime" << std::endl;
+  std::cout << std::setw(10) << "bits" << std::setw(14) << "miller-rabin" << std::setw(14) << "baillie-psw" << std::endl;
+  int sizes[] = {512, 1024, 2048};
+  BigInt::PrimalityTest tests[] = {BigInt::PrimalityTest::millerRabin, BigInt::PrimalityTest::bailliePSW};
+  for (int bits : sizes) {
+    int count = bits < 2048 ? 10 : 3;
+    std::cout << std::setw(10) << bits;
+    for (BigInt::PrimalityTest test : tests) {
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < count; ++i) {
+        BigInt::generatePrime(bits, test);
+      }
+      double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      std::cout << std::setw(14) << std::fixed << std::setprecision(1) << ms / count;
+    }
+    std::cout << std::endl;
+  }
+}
+
+int main()
+{
+  benchmarkMultiply();
+  benchmarkUnbalancedMultiply();
+  benchmarkKaratsubaMemory();
+  benchmarkParallelMultiply();
+  benchmarkIsPrime();
+  benchmarkGeneratePrime();
+  return 0;
+}
@@ -8,58 +8,77 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <cctype>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <random>
 #include <chrono>
 #include <stdexcept>
+#include <memory>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <exception>
 #include <functional>
+#include <system_error>
+#include <type_traits>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 
 #define VERSION "0.1.0"
 
+class MontgomeryContext;
+class BarrettReducer;
+
 class BigInt
 {
 public:
-  
+  // Magnitude is stored in 64-bit limbs, products and carries use 128-bit intermediates
+  typedef uint64_t limb_t;
+  __extension__ typedef unsigned __int128 dlimb_t;
+  static const int LIMB_BITS = 64;
+
   std::string getVersion() {
     return VERSION;
   }
 
-  BigInt() : bits(1, false) {}
+  BigInt() {}
 
-  BigInt(const std::string &str)
-  {
-    bits.assign(1, false); // Initialize to 0
-    if (str.empty() || str == "0" || str == "-0") {
-        return;
-    }
+  BigInt(const BigInt &other) : sign(other.sign), limbs(other.limbs) {}
 
-    std::string s = str;
-    bool is_neg = false;
-    if (s[0] == '-') {
-        is_neg = true;
-        s = s.substr(1);
-    }
+  // Takes over the limb buffer, the moved-from value is left as zero
+  BigInt(BigInt &&other) noexcept : sign(other.sign), limbs(std::move(other.limbs))
+  {
+    other.sign = false;
+  }
 
-    if (s.length() < 9) { // Use stoll for small strings, it's faster
-        long long num = std::stoll(s);
-        *this = BigInt(num);
-    } else { // Divide and conquer for large strings
-        size_t k = s.length() / 2;
-        std::string left_s = s.substr(0, s.length() - k);
-        std::string right_s = s.substr(s.length() - k);
+  BigInt(const std::string &str) : BigInt(str.data(), str.size()) {}
 
-        BigInt left(left_s);
-        BigInt right(right_s);
+  BigInt(const char *str) : BigInt(str, std::strlen(str)) {}
 
-        BigInt ten_k = BigInt(10).pow(k);
+#if __cplusplus >= 201703L
+  BigInt(std::string_view str) : BigInt(str.data(), str.size()) {}
+#endif
 
-        *this = left * ten_k + right;
-    }
+  // Parses an optional sign followed by decimal digits, an empty string is zero
+  BigInt(const char *str, size_t length)
+  {
+    parse(str, length, 10);
+  }
 
-    sign = is_neg;
-    trim();
+  // Parses an optional sign and digits in any base from 2 to 36, letters of either case
+  // stand for 10 to 35
+  static BigInt fromString(const std::string &str, int base)
+  {
+    BigInt result;
+    result.parse(str.data(), str.size(), base);
+    return result;
   }
+
   BigInt(int num)
   {
     *this = BigInt((long long int)num);
@@ -69,8 +88,18 @@ public:
   {
     if (&rhs == this)
       return *this;
-    bits = rhs.bits;
+    limbs = rhs.limbs;
+    sign = rhs.sign;
+    return *this;
+  }
+
+  BigInt &operator=(BigInt &&rhs) noexcept
+  {
+    if (&rhs == this)
+      return *this;
+    limbs = std::move(rhs.limbs);
     sign = rhs.sign;
+    rhs.sign = false;
     return *this;
   }
 
@@ -83,17 +112,14 @@ public:
   BigInt(long long int num)
   {
     if (num == 0) {
-      bits.push_back(false);
       return;
     }
+    unsigned long long mag = (unsigned long long)num;
     if (num < 0) {
       sign = true;
-      num = -num;
-    }
-    while (num > 0) {
-      bits.push_back(num % 2);
-      num /= 2;
+      mag = 0ULL - mag; // Well defined for LLONG_MIN as well
     }
+    limbs.push_back(mag);
   }
 
   BigInt operator+(const BigInt &rhs) const
@@ -108,27 +134,68 @@ public:
     return *this + BigInt(rhs);
   }
 
+#ifdef FBIGINT_EXPRESSION_TEMPLATES
+  class Product;
+
+  // Deferred a * b that fuses with a following %, + or -, see Product
+  Product operator*(const BigInt &rhs) const
+  {
+    return Product(*this, rhs);
+  }
+
+  BigInt &operator+=(const Product &rhs);
+  BigInt &operator-=(const Product &rhs);
+#else
   BigInt operator*(const BigInt &rhs) const
+  {
+    return multiply(rhs);
+  }
+#endif
+
+  // this * rhs evaluated right away
+  BigInt multiply(const BigInt &rhs) const
   {
     if (!(*this) || !rhs) {
         return BigInt(0);
     }
+    if (&rhs == this) {
+        return square();
+    }
+    if (limbs.size() == 1 && rhs.limbs.size() == 1) {
+        return fromWide((dlimb_t)limbs[0] * rhs.limbs[0], sign != rhs.sign);
+    }
 
-    BigInt result = this->abs().karatsubaMultiply(rhs.abs());
+    BigInt result = multiplyMagnitude(*this, rhs);
     result.sign = (sign != rhs.sign);
     result.trim();
     return result;
   }
 
+  // this * this. Every multiplication tier has a squaring variant that evaluates the operand
+  // only once, and the schoolbook kernel computes each cross product a single time.
+  BigInt square() const
+  {
+    if (!(*this)) {
+        return BigInt(0);
+    }
+    if (limbs.size() == 1) {
+        return fromWide((dlimb_t)limbs[0] * limbs[0], false);
+    }
+
+    BigInt result = multiplyMagnitude(*this, *this);
+    result.trim();
+    return result;
+  }
+
   BigInt operator^(const BigInt &rhs) const
   {
     BigInt result;
-    size_t size = std::max(bits.size(), rhs.bits.size());
-    result.bits.resize(size);
+    size_t size = std::max(limbs.size(), rhs.limbs.size());
+    result.limbs.resize(size);
     for (size_t i = 0; i < size; ++i) {
-        bool this_bit = (i < bits.size()) ? bits[i] : false;
-        bool rhs_bit = (i < rhs.bits.size()) ? rhs.bits[i] : false;
-        result.bits[i] = this_bit ^ rhs_bit;
+        limb_t this_limb = (i < limbs.size()) ? limbs[i] : 0;
+        limb_t rhs_limb = (i < rhs.limbs.size()) ? rhs.limbs[i] : 0;
+        result.limbs[i] = this_limb ^ rhs_limb;
     }
     result.trim();
     return result;
@@ -140,49 +207,231 @@ public:
     return *this;
   }
 
+  // Multiplies magnitudes, the sign of the result is always positive. The recursion works on
+  // views into the operands and writes every intermediate into one scratch buffer of
+  // karatsubaScratchSize() limbs, so a product costs two allocations at any depth.
   BigInt karatsubaMultiply(const BigInt &rhs) const
   {
-    size_t n = std::max(bits.size(), rhs.bits.size());
+    BigInt result;
+    if (!(*this) || !rhs) return result;
 
-    if (n < 32) { // Base case for small numbers
-        BigInt result;
-        if (!(*this) || !rhs) return result;
+    const BigInt &a = limbs.size() >= rhs.limbs.size() ? *this : rhs;
+    const BigInt &b = limbs.size() >= rhs.limbs.size() ? rhs : *this;
+    size_t an = a.limbs.size(), bn = b.limbs.size();
+    result.limbs.resize(an + bn);
 
-        for (size_t i = 0; i < rhs.bits.size(); ++i) {
-            if (rhs.bits[i]) {
-                result += (*this << (int)i);
-            }
-        }
-        return result;
+    LimbVector scratch;
+    if (&rhs == this) {
+        scratch.resize(karatsubaScratchN(an));
+        karatsubaSqrN(result.limbs.data(), a.limbs.data(), an, scratch.data());
+    } else {
+        scratch.resize(karatsubaScratch(an, bn));
+        karatsubaMul(result.limbs.data(), a.limbs.data(), an, b.limbs.data(), bn, scratch.data());
     }
+    result.trim();
+    return result;
+  }
 
-    size_t k = n / 2;
-
-    BigInt high1, low1, high2, low2;
+  // Limbs of scratch karatsubaMultiply allocates for operands of an and bn limbs
+  static size_t karatsubaScratchSize(size_t an, size_t bn)
+  {
+    return karatsubaScratch(std::max(an, bn), std::min(an, bn));
+  }
 
-    if (bits.size() > k) {
-        low1.bits.assign(bits.begin(), bits.begin() + k);
-        high1.bits.assign(bits.begin() + k, bits.end());
-    } else {
-        low1 = *this;
+  // Toom-Cook 3-way product of the magnitudes: both operands are split into three parts,
+  // evaluated at 0, 1, -1, -2 and infinity, multiplied pointwise (five products of a third
+  // of the size) and interpolated with Bodrato's sequence. The sign of the result is positive.
+  BigInt toom3Multiply(const BigInt &rhs) const
+  {
+    if (!(*this) || !rhs) {
+        return BigInt(0);
     }
 
-    if (rhs.bits.size() > k) {
-        low2.bits.assign(rhs.bits.begin(), rhs.bits.begin() + k);
-        high2.bits.assign(rhs.bits.begin() + k, rhs.bits.end());
+    size_t n = std::max(limbs.size(), rhs.limbs.size());
+    size_t k = (n + 2) / 3;
+    size_t part = k * LIMB_BITS;
+    size_t rest = n * LIMB_BITS;
+
+    BigInt a0 = bitSlice(0, part), a1 = bitSlice(part, part), a2 = bitSlice(2 * part, rest);
+
+    // Evaluation
+    BigInt pa = a0 + a2;
+    BigInt a_1 = pa + a1;
+    BigInt a_m1 = pa - a1;
+    BigInt a_m2 = ((a_m1 + a2) << 1) - a0;
+
+    BigInt r0, r1, r_m1, r_m2, r_inf;
+    if (&rhs == this) { // Squaring, the second operand needs no evaluation of its own
+        std::function<void()> products[5] = {
+            [&] { r0 = a0.square(); },
+            [&] { r1 = a_1.square(); },
+            [&] { r_m1 = a_m1.square(); },
+            [&] { r_m2 = a_m2.square(); },
+            [&] { r_inf = a2.square(); }};
+        runProducts(products, 5, n);
     } else {
-        low2 = rhs;
+        BigInt b0 = rhs.bitSlice(0, part), b1 = rhs.bitSlice(part, part), b2 = rhs.bitSlice(2 * part, rest);
+        BigInt pb = b0 + b2;
+        BigInt b_1 = pb + b1;
+        BigInt b_m1 = pb - b1;
+        BigInt b_m2 = ((b_m1 + b2) << 1) - b0;
+
+        std::function<void()> products[5] = {
+            [&] { r0 = a0.multiply(b0); },
+            [&] { r1 = a_1.multiply(b_1); },
+            [&] { r_m1 = a_m1.multiply(b_m1); },
+            [&] { r_m2 = a_m2.multiply(b_m2); },
+            [&] { r_inf = a2.multiply(b2); }};
+        runProducts(products, 5, n);
     }
 
-    high1.trim(); low1.trim(); high2.trim(); low2.trim();
+    // Interpolation, every division is exact
+    BigInt t3 = (r_m2 - r1) / 3;
+    BigInt t1 = (r1 - r_m1) >> 1;
+    BigInt t2 = r_m1 - r0;
+    t3 = ((t2 - t3) >> 1) + (r_inf << 1);
+    t2 += t1 - r_inf;
+    t1 -= t3;
+
+    int shift = (int)part;
+    BigInt result = r0;
+    result += t1 << shift;
+    result += t2 << (2 * shift);
+    result += t3 << (3 * shift);
+    result += r_inf << (4 * shift);
+    return result;
+  }
+
+  // Limb counts of the smaller operand at which operator* moves from schoolbook to Karatsuba
+  // and from Karatsuba to Toom-3. They are process wide and meant to be set once at startup,
+  // benchmark.cpp shows where each algorithm wins on a given machine.
+  static size_t &karatsubaThreshold()
+  {
+    static size_t threshold = 32;
+    return threshold;
+  }
+
+  static size_t &toom3Threshold()
+  {
+    static size_t threshold = 1536;
+    return threshold;
+  }
+
+  static size_t &nttThreshold()
+  {
+    static size_t threshold = 16384;
+    return threshold;
+  }
+
+  // Threads one multiplication may spread over, 1 (the default) keeps every product on the
+  // calling thread. From parallelMultiplyThreshold() limbs on, the three half products of a
+  // Karatsuba level, the five pointwise products of Toom-3 and the transforms of the three
+  // NTT primes start on helper threads while fewer than multiplyThreads() threads are busy
+  // in total, and run inline otherwise. Every setting gives bit-identical results.
+  static unsigned &multiplyThreads()
+  {
+    static unsigned threads = 1;
+    return threads;
+  }
+
+  static size_t &parallelMultiplyThreshold()
+  {
+    static size_t threshold = 1536;
+    return threshold;
+  }
+
+  // Exact product of the magnitudes by number theoretic transforms modulo three 62-bit primes,
+  // recombined with the Chinese remainder theorem. Limbs are used directly as coefficients.
+  // The primes c * 2^50 + 1 only have roots of unity for transforms up to 2^50 points, so
+  // an + bn - 1 may be at most 2^50, otherwise std::length_error is thrown; the 186-bit
+  // modulus product holds every coefficient up to that length. The sign of the result is
+  // positive.
+  BigInt nttMultiply(const BigInt &rhs) const
+  {
+    if (!(*this) || !rhs) {
+        return BigInt(0);
+    }
 
-    BigInt z0 = low1.karatsubaMultiply(low2);
-    BigInt z2 = high1.karatsubaMultiply(high2);
-    BigInt z1 = (low1 + high1).karatsubaMultiply(low2 + high2);
+    size_t an = limbs.size(), bn = rhs.limbs.size();
+    size_t terms = an + bn - 1;
+    if (terms > (size_t(1) << 50)) {
+        throw std::length_error("Operands too long for nttMultiply");
+    }
+    size_t n = 1;
+    while (n < terms) {
+        n <<= 1;
+    }
+    bool squaring = (limbs.data() == rhs.limbs.data());
+
+    // One task per prime, each with its own transform buffers
+    const NttPrime *primes = nttPrimes();
+    std::vector<limb_t> residues[3];
+    std::function<void()> transforms[3];
+    for (int k = 0; k < 3; ++k) {
+        transforms[k] = [&, k] {
+            const NttPrime &P = primes[k];
+            std::vector<limb_t> fb, roots, inverse_roots;
+            P.roots(n, roots, inverse_roots);
+
+            std::vector<limb_t> &fa = residues[k];
+            fa.assign(n, 0);
+            for (size_t i = 0; i < an; ++i) {
+                fa[i] = limbs[i] % P.p;
+            }
+            nttForward(fa.data(), n, P, roots.data());
+            if (squaring) {
+                for (size_t i = 0; i < n; ++i) {
+                    fa[i] = P.mul(fa[i], fa[i]);
+                }
+            } else {
+                fb.assign(n, 0);
+                for (size_t i = 0; i < bn; ++i) {
+                    fb[i] = rhs.limbs[i] % P.p;
+                }
+                nttForward(fb.data(), n, P, roots.data());
+                for (size_t i = 0; i < n; ++i) {
+                    fa[i] = P.mul(fa[i], fb[i]);
+                }
+            }
+            nttInverse(fa.data(), n, P, inverse_roots.data());
 
-    BigInt temp = z1 - z2 - z0;
+            // The pointwise products carry an extra R^-1, fold R^2 into the 1/n scaling
+            limb_t n_inv = P.p - (P.p - 1) / n;
+            limb_t scale = P.mul(P.mul(n_inv, P.r2), P.r2);
+            for (size_t i = 0; i < terms; ++i) {
+                fa[i] = P.mul(fa[i], scale);
+            }
+        };
+    }
+    runProducts(transforms, 3, std::min(an, bn));
 
-    return (z2 << (2 * (int)k)) + (temp << (int)k) + z0;
+    // Garner reconstruction x = r1 + v2 * p1 + v3 * p1 * p2 of each coefficient, added into
+    // the result at its limb position with a running 128-bit carry
+    const NttPrime &P1 = primes[0], &P2 = primes[1], &P3 = primes[2];
+    const NttCrt &crt = nttCrt();
+    BigInt result;
+    result.limbs.resize(an + bn);
+    limb_t c0 = 0, c1 = 0;
+    for (size_t i = 0; i < terms; ++i) {
+        limb_t r1 = residues[0][i], r2 = residues[1][i], r3 = residues[2][i];
+        limb_t v2 = P2.mul(P2.sub(r2, r1 >= P2.p ? r1 - P2.p : r1), crt.inv_p1_mod_p2);
+        limb_t partial = P3.add(r1 >= P3.p ? r1 - P3.p : r1, P3.mul(v2, crt.p1_mod_p3));
+        limb_t v3 = P3.mul(P3.sub(r3, partial), crt.inv_p1p2_mod_p3);
+
+        dlimb_t low = (dlimb_t)v2 * P1.p + r1;
+        dlimb_t mid = (dlimb_t)v3 * (limb_t)crt.p1p2;
+        dlimb_t high = (dlimb_t)v3 * (limb_t)(crt.p1p2 >> LIMB_BITS);
+
+        dlimb_t sum0 = (dlimb_t)(limb_t)low + (limb_t)mid + c0;
+        result.limbs[i] = (limb_t)sum0;
+        dlimb_t sum1 = (sum0 >> LIMB_BITS) + (limb_t)(low >> LIMB_BITS) + (limb_t)(mid >> LIMB_BITS)
+                       + (limb_t)high + c1;
+        c0 = (limb_t)sum1;
+        c1 = (limb_t)(sum1 >> LIMB_BITS) + (limb_t)(high >> LIMB_BITS);
+    }
+    result.limbs[terms] = c0;
+    result.trim();
+    return result;
   }
 
   BigInt &operator*=(const BigInt &rhs)
@@ -194,53 +443,112 @@ public:
   bool operator==(const BigInt &rhs) const
   {
     if (sign != rhs.sign) return false;
-    if (bits.size() != rhs.bits.size()) return false;
-    return bits == rhs.bits;
+    if (limbs.size() != rhs.limbs.size()) return false;
+    return limbs == rhs.limbs;
   }
 
   BigInt &operator+=(const BigInt &rhs)
   {
-    if (sign == rhs.sign) {
+    return addSigned(rhs, rhs.sign);
+  }
+
+  // *this += a * b, accumulated row by row into this value's own limbs
+  BigInt &addMul(const BigInt &a, const BigInt &b)
+  {
+    return addMulSigned(a, b, false);
+  }
+
+  // *this -= a * b
+  BigInt &subMul(const BigInt &a, const BigInt &b)
+  {
+    return addMulSigned(a, b, true);
+  }
+
+  // (a * b) % m with the sign convention of operator%. Below the Burnikel-Ziegler size the
+  // product and quotient share one scratch buffer and only the remainder becomes a BigInt.
+  static BigInt mulMod(const BigInt &a, const BigInt &b, const BigInt &m)
+  {
+    if (!m) {
+        throw std::invalid_argument("Division by zero");
+    }
+    size_t an = a.limbs.size(), bn = b.limbs.size(), mn = m.limbs.size();
+    if (!an || !bn) {
+        return BigInt(0);
+    }
+    if (mn >= BURNIKEL_ZIEGLER_THRESHOLD || std::min(an, bn) >= toom3Threshold()) {
+        return a.multiply(b) % m;
+    }
+
+    const BigInt &x = an >= bn ? a : b;
+    const BigInt &y = an >= bn ? b : a;
+    size_t xn = x.limbs.size(), yn = y.limbs.size(), pn = xn + yn;
+    bool squaring = (&a == &b);
+    size_t scratch = squaring ? karatsubaScratchN(xn) : karatsubaScratch(xn, yn);
+
+    LimbVector work;
+    work.resize(pn + (pn + 1) + scratch);
+    limb_t *p = work.data(), *q = p + pn, *w = q + pn + 1;
+    if (squaring) {
+        karatsubaSqrN(p, x.limbs.data(), xn, w);
+    } else {
+        karatsubaMul(p, x.limbs.data(), xn, y.limbs.data(), yn, w);
+    }
+    while (pn > 0 && p[pn - 1] == 0) {
+        --pn;
+    }
+
+    BigInt result;
+    if (pn < mn || (pn == mn && cmpN(p, pn, m.limbs.data(), mn) < 0)) {
+        result.limbs.assign(p, p + pn);
+    } else {
+        result.limbs.resize(mn);
+        divmodN(q, result.limbs.data(), p, pn, m.limbs.data(), mn);
+    }
+    result.sign = (a.sign != b.sign);
+    result.trim();
+    return result;
+  }
+
+  // *this += (rhs_sign ? -|rhs| : |rhs|), which lets -= subtract without copying rhs
+  BigInt &addSigned(const BigInt &rhs, bool rhs_sign)
+  {
+    if (limbs.size() <= 1 && rhs.limbs.size() <= 1) {
+        // Both fit a word, the result in at most two limbs
+        limb_t a = limbs.empty() ? 0 : limbs[0];
+        limb_t b = rhs.limbs.empty() ? 0 : rhs.limbs[0];
+        if (sign == rhs_sign) {
+            *this = fromWide((dlimb_t)a + b, sign);
+        } else if (a >= b) {
+            *this = fromWide(a - b, sign);
+        } else {
+            *this = fromWide(b - a, rhs_sign);
+        }
+        return *this;
+    }
+
+    if (sign == rhs_sign) {
         // Same sign addition: a + b
-        bool carry = false;
-        size_t n = std::max(bits.size(), rhs.bits.size());
-        bits.resize(n, false);
-        for (size_t i = 0; i < n; ++i) {
-            bool rhs_bit = (i < rhs.bits.size()) ? rhs.bits[i] : false;
-            bool sum = bits[i] ^ rhs_bit ^ carry;
-            carry = (bits[i] && rhs_bit) || (bits[i] && carry) || (rhs_bit && carry);
-            bits[i] = sum;
+        size_t n = rhs.limbs.size();
+        if (limbs.size() < n) {
+            limbs.resize(n, 0);
         }
+        limb_t carry = addN(limbs.data(), limbs.data(), limbs.size(), rhs.limbs.data(), n);
         if (carry) {
-            bits.push_back(true);
+            limbs.push_back(carry);
         }
     } else {
         // Different signs: a - b or b - a
-        if (this->abs() >= rhs.abs()) {
+        if (cmpN(limbs.data(), limbs.size(), rhs.limbs.data(), rhs.limbs.size()) >= 0) {
             // |a| >= |b|, result sign is sign of a.
             // Perform |a| - |b|.
-            BigInt rhs_abs = rhs.abs();
-            bool borrow = false;
-            for (size_t i = 0; i < bits.size(); ++i) {
-                bool rhs_bit = (i < rhs_abs.bits.size()) ? rhs_abs.bits[i] : false;
-                bool diff = bits[i] ^ rhs_bit ^ borrow;
-                borrow = (!bits[i] && borrow) || (!bits[i] && rhs_bit) || (borrow && rhs_bit);
-                bits[i] = diff;
-            }
+            subN(limbs.data(), limbs.data(), limbs.size(), rhs.limbs.data(), rhs.limbs.size());
         } else {
             // |a| < |b|, result sign is sign of b.
-            // Perform |b| - |a|.
-            BigInt this_abs = this->abs();
-            bits = rhs.bits; // start with |b|
-            sign = rhs.sign;
-
-            bool borrow = false;
-            for (size_t i = 0; i < bits.size(); ++i) {
-                bool lhs_bit = (i < this_abs.bits.size()) ? this_abs.bits[i] : false;
-                bool diff = bits[i] ^ lhs_bit ^ borrow;
-                borrow = (!bits[i] && borrow) || (!bits[i] && lhs_bit) || (borrow && lhs_bit);
-                bits[i] = diff;
-            }
+            // Perform |b| - |a| in place, subN reads each limb before writing it.
+            size_t n = limbs.size();
+            limbs.resize(rhs.limbs.size(), 0);
+            subN(limbs.data(), rhs.limbs.data(), rhs.limbs.size(), limbs.data(), n);
+            sign = rhs_sign;
         }
     }
     trim();
@@ -249,7 +557,7 @@ public:
 
   bool operator==(const int &rhs) const
   {
-    return *this == BigInt(rhs);
+    return compareSmall(rhs) == 0;
   }
 
   std::pair<BigInt, BigInt> divmod(const BigInt &divisor) const
@@ -260,26 +568,26 @@ public:
     if (*this == 0) {
         return {BigInt(0), BigInt(0)};
     }
+    if (limbs.size() == 1 && divisor.limbs.size() == 1) {
+        return {fromWide(limbs[0] / divisor.limbs[0], sign != divisor.sign), fromWide(limbs[0] % divisor.limbs[0], sign)};
+    }
 
-    BigInt dividend_abs = this->abs();
-    BigInt divisor_abs = divisor.abs();
-
-    if (dividend_abs < divisor_abs) {
+    if (cmpN(limbs.data(), limbs.size(), divisor.limbs.data(), divisor.limbs.size()) < 0) {
         return {BigInt(0), *this};
     }
 
     BigInt quotient;
     BigInt remainder;
 
-    quotient.bits.assign(dividend_abs.bits.size(), false);
-
-    for (int i = dividend_abs.bits.size() - 1; i >= 0; i--) {
-        remainder <<= 1;
-        remainder.bits[0] = dividend_abs.bits[i];
-        if (remainder >= divisor_abs) {
-            remainder -= divisor_abs;
-            quotient.bits[i] = true;
-        }
+    size_t n = divisor.limbs.size();
+    if (n >= BURNIKEL_ZIEGLER_THRESHOLD && limbs.size() - n >= BURNIKEL_ZIEGLER_THRESHOLD) {
+        std::pair<BigInt, BigInt> qr = divmodRecursive(this->abs(), divisor.abs());
+        quotient = std::move(qr.first);
+        remainder = std::move(qr.second);
+    } else {
+        quotient.limbs.resize(limbs.size() - n + 1);
+        remainder.limbs.resize(n);
+        divmodN(quotient.limbs.data(), remainder.limbs.data(), limbs.data(), limbs.size(), divisor.limbs.data(), n);
     }
 
     quotient.sign = (this->sign != divisor.sign);
@@ -288,13 +596,11 @@ public:
     remainder.sign = this->sign;
     remainder.trim();
 
-    return {quotient, remainder};
+    return {std::move(quotient), std::move(remainder)};
   }
 
-  BigInt operator%(const BigInt &divisor) const
-  {
-    return divmod(divisor).second;
-  }
+  // Repeated reductions by the same divisor switch to a cached BarrettReducer
+  BigInt operator%(const BigInt &divisor) const;
 
   BigInt operator%(const int &rhs) const
   {
@@ -309,7 +615,7 @@ public:
 
   operator bool() const
   {
-    return bits.size() > 1 || (bits.size() == 1 && bits[0]);
+    return !limbs.empty();
   }
 
   BigInt operator/(const BigInt &rhs) const
@@ -317,14 +623,14 @@ public:
     return divmod(rhs).first;
   }
 
-  // Helper function to trim leading zeros
+  // Helper function to trim leading zero limbs
   void trim()
   {
-    while (bits.size() > 1 && bits.back() == false)
+    while (!limbs.empty() && limbs.back() == 0)
     {
-      bits.pop_back();
+      limbs.pop_back();
     }
-    if (bits.size() == 1 && bits[0] == false) {
+    if (limbs.empty()) {
         sign = false; // Canonical representation for 0
     }
   }
@@ -336,7 +642,7 @@ public:
 
   bool operator<=(const int &rhs) const
   {
-    return *this <= BigInt(rhs);
+    return compareSmall(rhs) <= 0;
   }
 
   BigInt operator/(const int &rhs) const
@@ -362,6 +668,59 @@ public:
     return !(*this < rhs);
   }
 
+  bool operator>=(const int &rhs) const
+  {
+    return compareSmall(rhs) >= 0;
+  }
+
+  // Digits in a base from 2 to 36, lowercase letters and a leading '-' for negative values.
+  // Power-of-two bases are a linear repack of the bits. Other bases split the value
+  // recursively by the cached powers chunk^(2^i) and write every part in place into one
+  // buffer whose width is a power of two number of chunks, leading zeros are dropped at the end.
+  std::string toString(int base = 10) const
+  {
+    Radix radix = radixInfo(base);
+    if (!(*this)) {
+        return "0";
+    }
+
+    size_t offset = sign ? 1 : 0;
+    std::string out;
+    if (radix.bits) {
+        size_t n = (bitLength() + radix.bits - 1) / radix.bits;
+        out.assign(offset + n, '0');
+        char *end = &out[0] + out.size();
+        for (size_t i = 0; i < n; ++i) {
+            size_t bit = i * radix.bits, idx = bit / LIMB_BITS, shift = bit % LIMB_BITS;
+            limb_t digit = limbs[idx] >> shift;
+            if (shift + radix.bits > LIMB_BITS && idx + 1 < limbs.size()) {
+                digit |= limbs[idx + 1] << (LIMB_BITS - shift);
+            }
+            end[-1 - (ptrdiff_t)i] = digitChar(digit & (limb_t)(base - 1));
+        }
+    } else {
+        // chunk > 2^64 / base, so a chunk carries more than 64 - ceil(log2(base)) bits
+        int log2_base = 0;
+        while ((1 << log2_base) < base) {
+            ++log2_base;
+        }
+        size_t digits = bitLength() * radix.digits / (LIMB_BITS - log2_base) + 1;
+        size_t level = 0;
+        while ((size_t(radix.digits) << level) < digits) {
+            ++level;
+        }
+        out.assign(offset + (size_t(radix.digits) << level), '0');
+        writeRadix(*this, level, &out[offset], radix);
+
+        size_t first = out.find_first_not_of('0', offset);
+        out.erase(offset, first - offset);
+    }
+    if (sign) {
+        out[0] = '-';
+    }
+    return out;
+  }
+
   BigInt abs() const
   {
     BigInt result = *this;
@@ -376,7 +735,7 @@ public:
 
   bool operator!=(const int &rhs) const
   {
-    return !(*this == BigInt(rhs));
+    return compareSmall(rhs) != 0;
   }
 
   bool operator>(const BigInt &rhs) const
@@ -386,18 +745,16 @@ public:
 
   bool operator>(const int &rhs) const
   {
-    return *this > BigInt(rhs);
+    return compareSmall(rhs) > 0;
   }
 
   BigInt operator&(const BigInt &rhs) const
   {
     BigInt result;
-    size_t size = std::max(bits.size(), rhs.bits.size());
-    result.bits.resize(size);
+    size_t size = std::min(limbs.size(), rhs.limbs.size());
+    result.limbs.resize(size);
     for (size_t i = 0; i < size; ++i) {
-        bool this_bit = (i < bits.size()) ? bits[i] : false;
-        bool rhs_bit = (i < rhs.bits.size()) ? rhs.bits[i] : false;
-        result.bits[i] = this_bit & rhs_bit;
+        result.limbs[i] = limbs[i] & rhs.limbs[i];
     }
     result.trim();
     return result;
@@ -421,12 +778,18 @@ public:
     if (shift == 0 || !(*this)) {
         return *this;
     }
-    if (shift >= (int)bits.size()) {
-        bits.assign(1, false);
+    size_t limb_shift = (size_t)shift / LIMB_BITS;
+    unsigned bit_shift = (unsigned)shift % LIMB_BITS;
+    if (limb_shift >= limbs.size()) {
+        limbs.clear();
         sign = false;
         return *this;
     }
-    bits.erase(bits.begin(), bits.begin() + shift);
+    limbs.erase(limbs.begin(), limbs.begin() + limb_shift);
+    if (bit_shift) {
+        rshiftN(limbs.data(), limbs.data(), limbs.size(), bit_shift);
+    }
+    trim();
     return *this;
   }
 
@@ -437,33 +800,23 @@ public:
     }
 
     // Signs are the same
+    if (limbs.size() <= 1 && rhs.limbs.size() <= 1) {
+        limb_t a = limbs.empty() ? 0 : limbs[0];
+        limb_t b = rhs.limbs.empty() ? 0 : rhs.limbs[0];
+        return sign ? a > b : a < b;
+    }
+    int cmp = cmpN(limbs.data(), limbs.size(), rhs.limbs.data(), rhs.limbs.size());
     if (sign) { // Both negative
         // For negative numbers, bigger magnitude means smaller value.
-        if (bits.size() != rhs.bits.size()) {
-            return bits.size() > rhs.bits.size();
-        }
-        for (int i = bits.size() - 1; i >= 0; --i) {
-            if (bits[i] != rhs.bits[i]) {
-                return bits[i];
-            }
-        }
-        return false; // equal
+        return cmp > 0;
     } else { // Both positive
-        if (bits.size() != rhs.bits.size()) {
-            return bits.size() < rhs.bits.size();
-        }
-        for (int i = bits.size() - 1; i >= 0; --i) {
-            if (bits[i] != rhs.bits[i]) {
-                return !bits[i];
-            }
-        }
-        return false; // equal
+        return cmp < 0;
     }
   }
 
   bool operator<(const int &rhs) const
   {
-    return *this < BigInt(rhs);
+    return compareSmall(rhs) < 0;
   }
 
   BigInt operator>>(int shift) const
@@ -481,7 +834,17 @@ public:
     if (shift == 0 || !(*this)) {
         return *this;
     }
-    bits.insert(bits.begin(), shift, false);
+    size_t limb_shift = (size_t)shift / LIMB_BITS;
+    unsigned bit_shift = (unsigned)shift % LIMB_BITS;
+    if (bit_shift) {
+        limb_t high = lshiftN(limbs.data(), limbs.data(), limbs.size(), bit_shift);
+        if (high) {
+            limbs.push_back(high);
+        }
+    }
+    if (limb_shift) {
+        limbs.insert(limbs.begin(), limb_shift, 0);
+    }
     return *this;
   }
 
@@ -499,19 +862,30 @@ public:
       throw std::invalid_argument("Negative exponent is not allowed for BigInt::pow");
     }
 
-    BigInt base = *this;
-    BigInt result = 1;
+    BigInt exp(exponent);
+    int window = windowBits(exp.bitLength());
 
-    while (exponent > 0)
-    {
-      if (exponent & 1)
-      {
-        result *= base;
-      }
-      base *= base;
-      exponent >>= 1;
+    // Odd powers of the base for the sliding window
+    std::vector<BigInt> table(size_t(1) << (window - 1));
+    table[0] = *this;
+    if (window > 1) {
+        BigInt sq = square();
+        for (size_t i = 1; i < table.size(); ++i) {
+            table[i] = table[i - 1] * sq;
+        }
     }
 
+    BigInt result = 1;
+    slidingWindowPow(exp, window,
+        [&]() { result = result.square(); },
+        [&](size_t idx, bool started) {
+            if (started) {
+                result *= table[idx];
+            } else {
+                result = table[idx];
+            }
+        });
+
     return result;
   }
 
@@ -531,12 +905,12 @@ public:
   BigInt operator|(const BigInt &rhs) const
   {
     BigInt result;
-    size_t size = std::max(bits.size(), rhs.bits.size());
-    result.bits.resize(size);
+    size_t size = std::max(limbs.size(), rhs.limbs.size());
+    result.limbs.resize(size);
     for (size_t i = 0; i < size; ++i) {
-        bool this_bit = (i < bits.size()) ? bits[i] : false;
-        bool rhs_bit = (i < rhs.bits.size()) ? rhs.bits[i] : false;
-        result.bits[i] = this_bit | rhs_bit;
+        limb_t this_limb = (i < limbs.size()) ? limbs[i] : 0;
+        limb_t rhs_limb = (i < rhs.limbs.size()) ? rhs.limbs[i] : 0;
+        result.limbs[i] = this_limb | rhs_limb;
     }
     result.trim();
     return result;
@@ -556,12 +930,7 @@ public:
 
   BigInt &operator-=(const BigInt &rhs)
   {
-    BigInt temp = rhs;
-    if (temp != 0) {
-      temp.sign = !temp.sign;
-    }
-    *this += temp;
-    return *this;
+    return addSigned(rhs, rhs ? !rhs.sign : false);
   }
 
   BigInt operator-(const BigInt &rhs) const
@@ -576,78 +945,277 @@ public:
     return *this - BigInt(rhs);
   }
 
-  static BigInt generateRandom(int bitLength)
+  // Number of significant bits in the magnitude, 0 for zero
+  size_t bitLength() const
   {
-    if (bitLength <= 0) return BigInt(0);
-    std::mt19937 generator(std::chrono::steady_clock::now().time_since_epoch().count());
-    std::uniform_int_distribution<int> distribution(0, 1);
+    if (limbs.empty()) return 0;
+    size_t n = (limbs.size() - 1) * LIMB_BITS;
+    for (limb_t top = limbs.back(); top; top >>= 1) {
+        n++;
+    }
+    return n;
+  }
+
+  // Tests bit i of the magnitude
+  bool testBit(size_t i) const
+  {
+    size_t idx = i / LIMB_BITS;
+    return idx < limbs.size() && ((limbs[idx] >> (i % LIMB_BITS)) & 1);
+  }
+
+  // Word and byte order for exportBytes and importBytes, native is the order of the host
+  enum class Endian { little, big, native };
+
+  // Bytes exportBytes writes for this magnitude: the significant bytes rounded up to whole
+  // words, 0 for zero
+  size_t exportSize(size_t word_size = 1) const
+  {
+    if (word_size == 0) {
+        throw std::invalid_argument("Word size must be positive");
+    }
+    size_t bytes = (bitLength() + 7) / 8;
+    return (bytes + word_size - 1) / word_size * word_size;
+  }
+
+  // Writes the magnitude as exportSize(word_size) bytes of word_size-byte words, like
+  // mpz_export. order picks whether the most significant word comes first (big) or last
+  // (little), endian the byte order inside each word; the top word is zero padded. The
+  // defaults give a big-endian byte string. Returns the number of bytes written and throws
+  // std::length_error if size is too small. Little words in little bytes on a little-endian
+  // host is the in-memory limb layout and copies straight from the limbs.
+  size_t exportBytes(void *out, size_t size, size_t word_size = 1, Endian order = Endian::big,
+                     Endian endian = Endian::big) const
+  {
+    size_t total = exportSize(word_size);
+    if (size < total) {
+        throw std::length_error("Buffer too small for exportBytes");
+    }
+    order = resolveEndian(order);
+    endian = resolveEndian(endian);
+    unsigned char *bytes = static_cast<unsigned char *>(out);
+    size_t used = (bitLength() + 7) / 8;
+    if (order == Endian::little && (endian == Endian::little || word_size == 1) &&
+        resolveEndian(Endian::native) == Endian::little) {
+        if (used) {
+            std::memcpy(bytes, limbs.data(), used);
+        }
+        std::memset(bytes + used, 0, total - used);
+        return total;
+    }
+
+    std::memset(bytes, 0, total);
+    size_t words = total / word_size;
+    for (size_t k = 0; k < used; ++k) {
+        bytes[byteOffset(k, words, word_size, order, endian)] =
+            (unsigned char)(limbs[k / sizeof(limb_t)] >> (8 * (k % sizeof(limb_t))));
+    }
+    return total;
+  }
 
+  // Reads a non-negative value from size bytes laid out as exportBytes writes them, size
+  // must be a multiple of word_size
+  static BigInt importBytes(const void *data, size_t size, size_t word_size = 1,
+                            Endian order = Endian::big, Endian endian = Endian::big)
+  {
+    if (word_size == 0 || size % word_size != 0) {
+        throw std::invalid_argument("Size must be a multiple of a positive word size");
+    }
+    order = resolveEndian(order);
+    endian = resolveEndian(endian);
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
     BigInt result;
-    result.bits.resize(bitLength);
-    for (int i = 0; i < bitLength; ++i) {
-        result.bits[i] = distribution(generator);
+    result.limbs.resize((size + sizeof(limb_t) - 1) / sizeof(limb_t));
+    if (order == Endian::little && (endian == Endian::little || word_size == 1) &&
+        resolveEndian(Endian::native) == Endian::little) {
+        if (size) {
+            std::memcpy(result.limbs.data(), bytes, size);
+        }
+    } else {
+        size_t words = size / word_size;
+        for (size_t k = 0; k < size; ++k) {
+            result.limbs[k / sizeof(limb_t)] |=
+                (limb_t)bytes[byteOffset(k, words, word_size, order, endian)] << (8 * (k % sizeof(limb_t)));
+        }
     }
-    // Ensure the most significant bit is 1 to have the desired bit length
-    result.bits[bitLength - 1] = true;
     result.trim();
     return result;
   }
 
-  bool millerRabinTest(BigInt d) const {
-    BigInt a = 2 + BigInt::generateRandom(bits.size() - 2) % (*this - 4);
-    BigInt x = modPow(a, d, *this);
+  // Read-only view of the magnitude, least significant limb first and no leading zero limbs
+  // (empty for zero). Valid until the value is next modified.
+  const limb_t *limbData() const
+  {
+    return limbs.data();
+  }
+
+  size_t limbCount() const
+  {
+    return limbs.size();
+  }
 
-    if (x == 1 || x == *this - 1) {
-        return true;
+  // Per-thread 64-bit Mersenne Twister seeded once from std::random_device and the clock,
+  // the default source of generateRandom, randomBelow and the Miller-Rabin bases. Not
+  // suitable for secret keys, pass a cryptographic generator to the overloads for those.
+  static std::mt19937_64 &randomEngine()
+  {
+    thread_local std::mt19937_64 engine = [] {
+        std::random_device device;
+        std::seed_seq seed{device(), device(), device(), device(),
+                           (unsigned)std::chrono::steady_clock::now().time_since_epoch().count()};
+        return std::mt19937_64(seed);
+    }();
+    return engine;
+  }
+
+  // Random value of exactly bitLength bits (the top bit is set), filled a limb per draw
+  // from any uniform random bit generator
+  template <class URBG>
+  static BigInt generateRandom(int bitLength, URBG &generator)
+  {
+    if (bitLength <= 0) return BigInt(0);
+    BigInt result = randomBits(bitLength, generator);
+    // Ensure the most significant bit is 1 to have the desired bit length
+    if (result.limbs.size() < size_t(bitLength + LIMB_BITS - 1) / LIMB_BITS) {
+        result.limbs.resize((bitLength + LIMB_BITS - 1) / LIMB_BITS);
     }
+    result.limbs.back() |= limb_t(1) << ((bitLength - 1) % LIMB_BITS);
+    return result;
+  }
 
-    while (d != *this - 1) {
-        x = (x * x) % *this;
-        d <<= 1;
-        if (x == 1) return false;
-        if (x == *this - 1) return true;
+  static BigInt generateRandom(int bitLength)
+  {
+    return generateRandom(bitLength, randomEngine());
+  }
+
+  // Uniform value in [0, n) for n > 0, by rejection on n.bitLength() random bits, which
+  // takes fewer than two draws on average
+  template <class URBG>
+  static BigInt randomBelow(const BigInt &n, URBG &generator)
+  {
+    if (n <= 0) {
+        throw std::invalid_argument("randomBelow needs a positive bound");
+    }
+    for (;;) {
+        BigInt candidate = randomBits(n.bitLength(), generator);
+        if (cmpN(candidate.limbs.data(), candidate.limbs.size(), n.limbs.data(), n.limbs.size()) < 0) {
+            return candidate;
+        }
     }
+  }
 
-    return false;
+  static BigInt randomBelow(const BigInt &n)
+  {
+    return randomBelow(n, randomEngine());
   }
 
-  bool isPrime(int k = 20) const {
-    if (*this <= 1 || *this == 4) return false;
-    if (*this <= 3) return true;
-    if (this->isEven()) return false;
+  // One Miller-Rabin round with a random base, d is the odd part of *this - 1
+  bool millerRabinTest(BigInt d) const;
+  bool millerRabinTest(const BigInt &d, const MontgomeryContext &ctx) const;
+  // The round for a given base 2 <= a <= *this - 2
+  bool millerRabinRound(const BigInt &a, const BigInt &d, const MontgomeryContext &ctx) const;
+  // Strong Lucas probable prime test for an odd value above 3 that is not a perfect square
+  bool strongLucasTest(const MontgomeryContext &ctx) const;
+
+  // k Miller-Rabin rounds. With threads > 1 (0 for one per hardware thread) the rounds are
+  // shared out to that many worker threads, and rounds not yet started are skipped as soon
+  // as one finds a witness. The bases are drawn up front, so the outcome does not depend on
+  // the thread count.
+  bool isPrime(int k = 20, unsigned threads = 1) const;
+
+  // Which test isPrime and generatePrime run: 20 random-base Miller-Rabin rounds, or
+  // Baillie-PSW, which costs about four exponentiations and has no known counterexample
+  enum class PrimalityTest { millerRabin, bailliePSW };
+
+  bool isPrime(PrimalityTest test) const
+  {
+    return test == PrimalityTest::bailliePSW ? isProbablePrimeBPSW() : isPrime();
+  }
 
-    BigInt d = *this - 1;
-    while (d.isEven()) {
-        d >>= 1;
-    }
+  // Trial division, a strong probable prime test to base 2 and a strong Lucas test with
+  // Selfridge's parameters (P = 1, Q = (1 - D) / 4 for the first D in 5, -7, 9, -11, ...
+  // with Jacobi symbol (D/n) = -1)
+  bool isProbablePrimeBPSW() const;
 
-    for (int i = 0; i < k; i++) {
-        if (!millerRabinTest(d)) return false;
-    }
+  // Jacobi symbol (a/n) for odd positive n, 0, 1 or -1
+  static int jacobi(BigInt a, BigInt n);
 
-    return true;
+  // Integer square root, the floor of the square root of a non-negative value
+  BigInt sqrt() const;
+
+  bool isPerfectSquare() const
+  {
+    if (sign) {
+        return false;
+    }
+    // Squares are 0, 1, 4 or 9 modulo 16
+    if (limbs.size() && ((0x213 >> (limbs[0] & 15)) & 1) == 0) {
+        return false;
+    }
+    BigInt root = sqrt();
+    return root.square() == *this;
   }
 
-  static BigInt generatePrime(int bitLength)
+  // First prime from a random odd start. The odd numbers after the start are sieved in
+  // windows by the small primes, stepping the start's residues from window to window, and
+  // only the survivors go to Miller-Rabin. The start is drawn from generator, the
+  // Miller-Rabin bases still come from randomEngine().
+  template <class URBG>
+  static BigInt generatePrime(int bitLength, URBG &generator, PrimalityTest test = PrimalityTest::millerRabin)
   {
-    BigInt candidate = BigInt::generateRandom(bitLength);
+    BigInt candidate = BigInt::generateRandom(bitLength, generator);
 
     // Make sure the candidate is odd.
     if (candidate.isEven()) {
       candidate += 1;
     }
 
-    while (!candidate.isPrime())
-    {
-      candidate += 2;
+    // A candidate that could be one of the sieving primes is tested directly
+    if (bitLength <= 32) {
+      while (!candidate.isPrime(test))
+      {
+        candidate += 2;
+      }
+      return candidate;
+    }
+
+    const std::vector<uint32_t> &primes = smallPrimes();
+    std::vector<uint32_t> residues = candidate.smallPrimeResidues();
+    std::vector<char> sieve(PRIME_SIEVE_WINDOW);
+    for (;;) {
+      // Entry i stands for candidate + 2i, p divides it from i = -residue / 2 mod p on
+      std::fill(sieve.begin(), sieve.end(), 0);
+      for (size_t j = 0; j < primes.size(); ++j) {
+        uint32_t p = primes[j];
+        size_t i = residues[j] ? (size_t)(p - residues[j]) * ((p + 1) / 2) % p : 0;
+        for (; i < sieve.size(); i += p) {
+          sieve[i] = 1;
+        }
+      }
+
+      for (size_t i = 0; i < sieve.size(); ++i) {
+        if (!sieve[i]) {
+          BigInt survivor = candidate + BigInt((long long)(2 * i));
+          if (survivor.isPrime(test)) {
+            return survivor;
+          }
+        }
+      }
+
+      candidate += BigInt((long long)(2 * sieve.size()));
+      for (size_t j = 0; j < primes.size(); ++j) {
+        residues[j] = (uint32_t)((residues[j] + 2 * sieve.size()) % primes[j]);
+      }
     }
+  }
 
-    return candidate;
+  static BigInt generatePrime(int bitLength, PrimalityTest test = PrimalityTest::millerRabin)
+  {
+    return generatePrime(bitLength, randomEngine(), test);
   }
 
   bool isEven() const
   {
-    return (bits.size() > 0 && !bits[0]);
+    return limbs.empty() || !(limbs[0] & 1);
   }
 
   static BigInt gcd(BigInt a, BigInt b)
@@ -680,20 +1248,10 @@ public:
     return a << shift;
   }
 
-  static BigInt modPow(BigInt base, BigInt exp, BigInt modulus)
-  {
-    if (modulus == 1) return 0;
-    BigInt result = 1;
-    base %= modulus;
-    while (exp > 0) {
-        if (!exp.isEven()) result = (result * base) % modulus;
-        base = (base * base) % modulus;
-        exp >>= 1;
-    }
-    return result;
-  }
-
-  static BigInt modInverse(BigInt a, BigInt p)
+  // Odd moduli are handled in Montgomery form, see MontgomeryContext
+  static BigInt modPow(BigInt base, BigInt exp, BigInt modulus);
+
+  static BigInt modInverse(BigInt a, BigInt p)
   {
     BigInt val(0);
     BigInt nt(1);
@@ -702,16 +1260,14 @@ public:
 
     while (nr != 0)
     {
-      auto dm = r.divmod(nr);
-      BigInt q = dm.first;
+      std::pair<BigInt, BigInt> dm = r.divmod(nr);
 
-      BigInt tmp = nt;
-      nt = val - q * nt;
-      val = tmp;
+      // (val, nt) = (nt, val - q * nt)
+      val.subMul(dm.first, nt);
+      std::swap(val, nt);
 
-      tmp = nr;
-      nr = dm.second;
-      r = tmp;
+      r = std::move(nr);
+      nr = std::move(dm.second);
     }
 
     if (r > 1) {
@@ -724,57 +1280,2288 @@ public:
     return val;
   }
 
+#ifdef FBIGINT_EXPRESSION_TEMPLATES
+  // With FBIGINT_EXPRESSION_TEMPLATES defined before including this header, a * b yields a
+  // Product holding references to both operands instead of the value. (a * b) % m,
+  // c + a * b, c - a * b and a * b - c then run as mulMod, addMul and subMul without a
+  // product temporary, and every other use converts to BigInt. A Product must not outlive
+  // its operands, so it should not be stored with auto, and the macro has to be the same in
+  // every translation unit of a program.
+  class Product
+  {
+  public:
+    Product(const BigInt &a, const BigInt &b) : a(a), b(b) {}
+
+    operator BigInt() const
+    {
+      return value();
+    }
+
+    BigInt value() const
+    {
+      return a.multiply(b);
+    }
+
+    friend BigInt operator%(const Product &p, const BigInt &m)
+    {
+      return mulMod(p.a, p.b, m);
+    }
+
+    friend BigInt operator+(const BigInt &c, const Product &p)
+    {
+      BigInt r = p.accumulator(c);
+      r.addMul(p.a, p.b);
+      return r;
+    }
+
+    friend BigInt operator+(BigInt &&c, const Product &p)
+    {
+      c.addMul(p.a, p.b);
+      return std::move(c);
+    }
+
+    friend BigInt operator+(const Product &p, const BigInt &c)
+    {
+      return c + p;
+    }
+
+    friend BigInt operator+(const Product &p, BigInt &&c)
+    {
+      return std::move(c) + p;
+    }
+
+    friend BigInt operator+(const Product &p, const Product &q)
+    {
+      BigInt sum = p.value();
+      sum.addMul(q.a, q.b);
+      return sum;
+    }
+
+    friend BigInt operator-(const BigInt &c, const Product &p)
+    {
+      BigInt r = p.accumulator(c);
+      r.subMul(p.a, p.b);
+      return r;
+    }
+
+    friend BigInt operator-(BigInt &&c, const Product &p)
+    {
+      c.subMul(p.a, p.b);
+      return std::move(c);
+    }
+
+    friend BigInt operator-(const Product &p, const BigInt &c)
+    {
+      return -(c - p);
+    }
+
+    friend BigInt operator-(const Product &p, BigInt &&c)
+    {
+      return -(std::move(c) - p);
+    }
+
+    friend BigInt operator-(const Product &p, const Product &q)
+    {
+      BigInt difference = p.value();
+      difference.subMul(q.a, q.b);
+      return difference;
+    }
+
+    friend BigInt operator+(const Product &p, const int &c)
+    {
+      return p + BigInt(c);
+    }
+
+    friend BigInt operator-(const Product &p, const int &c)
+    {
+      return p - BigInt(c);
+    }
+
+    friend BigInt operator-(const Product &p)
+    {
+      return -p.value();
+    }
+
+    // Everything else evaluates the product first
+    template <class T> friend BigInt operator*(const Product &p, const T &rhs) { return p.value() * rhs; }
+    template <class T> friend BigInt operator/(const Product &p, const T &rhs) { return p.value() / rhs; }
+    template <class T> friend BigInt operator%(const Product &p, const T &rhs) { return p.value() % rhs; }
+    template <class T> friend BigInt operator&(const Product &p, const T &rhs) { return p.value() & rhs; }
+    template <class T> friend BigInt operator|(const Product &p, const T &rhs) { return p.value() | rhs; }
+    template <class T> friend BigInt operator^(const Product &p, const T &rhs) { return p.value() ^ rhs; }
+    friend BigInt operator<<(const Product &p, int shift) { return p.value() << shift; }
+    friend BigInt operator>>(const Product &p, int shift) { return p.value() >> shift; }
+    template <class T> friend bool operator==(const Product &p, const T &rhs) { return p.value() == rhs; }
+    template <class T> friend bool operator!=(const Product &p, const T &rhs) { return p.value() != rhs; }
+    template <class T> friend bool operator<(const Product &p, const T &rhs) { return p.value() < rhs; }
+    template <class T> friend bool operator>(const Product &p, const T &rhs) { return p.value() > rhs; }
+    template <class T> friend bool operator<=(const Product &p, const T &rhs) { return p.value() <= rhs; }
+    template <class T> friend bool operator>=(const Product &p, const T &rhs) { return p.value() >= rhs; }
+
+  private:
+    friend class BigInt;
+
+    // Copy of c with room for c + a * b, so the fused kernel does not reallocate
+    BigInt accumulator(const BigInt &c) const
+    {
+      BigInt r;
+      r.limbs.reserve(std::max(c.limbs.size(), a.limbs.size() + b.limbs.size()) + 1);
+      r = c;
+      return r;
+    }
+
+    const BigInt &a;
+    const BigInt &b;
+  };
+#endif
+
   friend std::ostream &operator<<(std::ostream &os, const BigInt &bi);
 
+  // Overloads for expiring operands work in the operand's limb buffer, so a chain like
+  // a * b + c - d only allocates for the product
+  friend BigInt operator+(BigInt &&lhs, const BigInt &rhs)
+  {
+    lhs += rhs;
+    return std::move(lhs);
+  }
+
+  friend BigInt operator+(const BigInt &lhs, BigInt &&rhs)
+  {
+    rhs += lhs;
+    return std::move(rhs);
+  }
+
+  friend BigInt operator+(BigInt &&lhs, BigInt &&rhs)
+  {
+    lhs += rhs;
+    return std::move(lhs);
+  }
+
+  friend BigInt operator+(BigInt &&lhs, const int &rhs)
+  {
+    lhs += BigInt(rhs);
+    return std::move(lhs);
+  }
+
+  friend BigInt operator-(BigInt &&lhs, const BigInt &rhs)
+  {
+    lhs -= rhs;
+    return std::move(lhs);
+  }
+
+  friend BigInt operator-(const BigInt &lhs, BigInt &&rhs)
+  {
+    rhs -= lhs;
+    return -std::move(rhs);
+  }
+
+  friend BigInt operator-(BigInt &&lhs, BigInt &&rhs)
+  {
+    lhs -= rhs;
+    return std::move(lhs);
+  }
+
+  friend BigInt operator-(BigInt &&lhs, const int &rhs)
+  {
+    lhs -= BigInt(rhs);
+    return std::move(lhs);
+  }
+
+  friend BigInt operator-(BigInt &&value)
+  {
+    if (value) {
+        value.sign = !value.sign;
+    }
+    return std::move(value);
+  }
+
+  friend class MontgomeryContext;
+  friend class BarrettReducer;
+
+  // Number of limb buffers allocated on the heap so far, values that fit inline never allocate
+  static unsigned long long allocationCount()
+  {
+    return allocationCounter().load(std::memory_order_relaxed);
+  }
+
 private:
-  bool sign = false;      // false = positive, true = negative
-  std::vector<bool> bits; // bits are stored in reverse order, LSB first
-};
+  // Divisor and quotient limb count from which divmod recurses (Burnikel-Ziegler) instead of
+  // running Algorithm D directly
+  enum { BURNIKEL_ZIEGLER_THRESHOLD = 64 };
 
-inline std::ostream &operator<<(std::ostream &os, const BigInt &bi)
-{
-    if (!bi) {
-        os << "0";
-        return os;
+  static Endian resolveEndian(Endian endian)
+  {
+    if (endian != Endian::native) {
+        return endian;
     }
-    if (bi.sign) {
-        os << "-";
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return Endian::big;
+#else
+    return Endian::little;
+#endif
+  }
+
+  // Position of magnitude byte k (least significant first) in an exported buffer of `words`
+  // words, order and endian already resolved
+  static size_t byteOffset(size_t k, size_t words, size_t word_size, Endian order, Endian endian)
+  {
+    size_t word = k / word_size, byte = k % word_size;
+    if (order == Endian::big) {
+        word = words - 1 - word;
+    }
+    if (endian == Endian::big) {
+        byte = word_size - 1 - byte;
     }
+    return word * word_size + byte;
+  }
 
-    std::function<std::string(const BigInt&)> to_string_rec =
-        [&](const BigInt& n) -> std::string {
-        if (n.bits.size() < 60) {
-            long long val = 0;
-            for(size_t i = 0; i < n.bits.size(); ++i) {
-                if (n.bits[i]) {
-                    val |= (1LL << i);
-                }
+  // Value of a magnitude below 2^128 with the given sign, for the single-word fast paths
+  static BigInt fromWide(dlimb_t magnitude, bool negative)
+  {
+    BigInt result;
+    if (magnitude) {
+        result.limbs.push_back((limb_t)magnitude);
+        if (magnitude >> LIMB_BITS) {
+            result.limbs.push_back((limb_t)(magnitude >> LIMB_BITS));
+        }
+        result.sign = negative;
+    }
+    return result;
+  }
+
+  // Sign of *this - v, without building a BigInt for v
+  int compareSmall(long long v) const
+  {
+    bool v_negative = v < 0;
+    if (sign != v_negative) {
+        return sign ? -1 : 1;
+    }
+    if (limbs.size() > 1) {
+        return sign ? -1 : 1;
+    }
+    limb_t a = limbs.empty() ? 0 : limbs[0];
+    limb_t b = v_negative ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    if (a == b) {
+        return 0;
+    }
+    return (a < b) != sign ? -1 : 1;
+  }
+
+  // The checks isPrime and isProbablePrimeBPSW start with: values below 2, single limbs,
+  // even values and ones with a small factor. Returns true with the answer in prime when
+  // these settle it, otherwise false with odd_part set to the odd part of *this - 1.
+  bool screenPrimality(bool &prime, BigInt &odd_part) const;
+
+  // Deterministic Miller-Rabin below 2^64: the first twelve primes as bases have no common
+  // strong pseudoprime below 3.18 * 10^23. Products are taken in 128 bits.
+  static bool isPrimeWord(limb_t n)
+  {
+    static const limb_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+    if (n < 2) {
+        return false;
+    }
+    for (limb_t p : bases) {
+        if (n % p == 0) {
+            return n == p;
+        }
+    }
+
+    limb_t d = n - 1;
+    int s = 0;
+    while (!(d & 1)) {
+        d >>= 1;
+        ++s;
+    }
+    auto mulmod = [n](limb_t a, limb_t b) { return (limb_t)((dlimb_t)a * b % n); };
+    for (limb_t a : bases) {
+        limb_t x = 1;
+        for (limb_t base = a, e = d; e; e >>= 1) {
+            if (e & 1) {
+                x = mulmod(x, base);
+            }
+            base = mulmod(base, base);
+        }
+        if (x == 1 || x == n - 1) {
+            continue;
+        }
+        int r = 1;
+        for (; r < s; ++r) {
+            x = mulmod(x, x);
+            if (x == n - 1) {
+                break;
+            }
+        }
+        if (r == s) {
+            return false;
+        }
+    }
+    return true;
+  }
+
+  // Uniform value below 2^bits
+  template <class URBG>
+  static BigInt randomBits(size_t bits, URBG &generator)
+  {
+    std::uniform_int_distribution<limb_t> word;
+    BigInt result;
+    result.limbs.resize((bits + LIMB_BITS - 1) / LIMB_BITS);
+    for (size_t i = 0; i < result.limbs.size(); ++i) {
+        result.limbs[i] = word(generator);
+    }
+    if (bits % LIMB_BITS) {
+        result.limbs.back() &= (limb_t(1) << (bits % LIMB_BITS)) - 1;
+    }
+    result.trim();
+    return result;
+  }
+
+  // Sieving primes for generatePrime are the odd primes below this bound
+  enum { SMALL_PRIME_BOUND = 32768 };
+
+  // Odd numbers per generatePrime sieve window
+  enum { PRIME_SIEVE_WINDOW = 4096 };
+
+  // Odd primes below SMALL_PRIME_BOUND, from a sieve of Eratosthenes on first use
+  static const std::vector<uint32_t> &smallPrimes()
+  {
+    static const std::vector<uint32_t> primes = [] {
+        std::vector<bool> composite(SMALL_PRIME_BOUND);
+        std::vector<uint32_t> result;
+        for (uint32_t i = 3; i < SMALL_PRIME_BOUND; i += 2) {
+            if (composite[i]) {
+                continue;
+            }
+            result.push_back(i);
+            for (uint32_t j = i * i; j < SMALL_PRIME_BOUND; j += 2 * i) {
+                composite[j] = true;
+            }
+        }
+        return result;
+    }();
+    return primes;
+  }
+
+  // Odd primes isPrime divides by before Miller-Rabin, the ones below 1000
+  enum { TRIAL_DIVISION_PRIMES = 167 };
+
+  // The magnitude modulo m, one pass from the top limb down
+  limb_t modLimb(limb_t m) const
+  {
+    limb_t rem = 0;
+    for (size_t j = limbs.size(); j-- > 0;) {
+        rem = (limb_t)((((dlimb_t)rem << LIMB_BITS) | limbs[j]) % m);
+    }
+    return rem;
+  }
+
+  // Passes the magnitude modulo each of the first count smallPrimes() to visit(i, residue),
+  // stopping early once visit returns true. Consecutive primes are grouped while their
+  // product fits a limb, so one pass over the limbs serves the whole group.
+  template <class Visit>
+  void visitSmallPrimeResidues(size_t count, Visit visit) const
+  {
+    const std::vector<uint32_t> &primes = smallPrimes();
+    for (size_t i = 0; i < count;) {
+        size_t end = i;
+        limb_t product = 1;
+        while (end < count && product <= ~limb_t(0) / primes[end]) {
+            product *= primes[end++];
+        }
+        limb_t rem = modLimb(product);
+        for (; i < end; ++i) {
+            if (visit(i, (uint32_t)(rem % primes[i]))) {
+                return;
             }
-            return std::to_string(val);
         }
+    }
+  }
 
-        size_t num_digits_approx = (n.bits.size() * 1000) / 3322 + 1;
-        size_t k = num_digits_approx / 2;
-        if (k == 0) k = 1;
+  // Smallest of the first TRIAL_DIVISION_PRIMES odd primes that divides the magnitude, 0 if
+  // none does. A 2048-bit value costs some forty passes over its limbs, and the search
+  // stops at the first group with a hit.
+  uint32_t smallPrimeDivisor() const
+  {
+    uint32_t divisor = 0;
+    visitSmallPrimeResidues(TRIAL_DIVISION_PRIMES, [&divisor](size_t i, uint32_t residue) {
+        if (residue == 0) {
+            divisor = smallPrimes()[i];
+        }
+        return residue == 0;
+    });
+    return divisor;
+  }
 
-        BigInt ten_k = BigInt(10).pow(k);
-        auto dm = n.divmod(ten_k);
+  // The magnitude modulo each of smallPrimes()
+  std::vector<uint32_t> smallPrimeResidues() const
+  {
+    std::vector<uint32_t> residues(smallPrimes().size());
+    visitSmallPrimeResidues(residues.size(), [&residues](size_t i, uint32_t residue) {
+        residues[i] = residue;
+        return false;
+    });
+    return residues;
+  }
 
-        std::string r_str = to_string_rec(dm.second);
+  // How digits of a base pack into a limb: bits per digit for powers of two, otherwise the
+  // number of digits in the largest power of the base below 2^64 (19 for base 10)
+  struct Radix
+  {
+    int base;
+    int bits;     // log2(base) for powers of two, else 0
+    int digits;   // digits per chunk
+    limb_t chunk; // base^digits
+  };
 
-        if (dm.first == 0) {
-            return r_str;
+  static Radix radixInfo(int base)
+  {
+    if (base < 2 || base > 36) {
+        throw std::invalid_argument("Base must be between 2 and 36");
+    }
+    Radix radix;
+    radix.base = base;
+    radix.bits = 0;
+    if ((base & (base - 1)) == 0) {
+        while ((1 << radix.bits) < base) {
+            ++radix.bits;
         }
+    }
+    radix.digits = 0;
+    radix.chunk = 1;
+    while (radix.chunk <= ~limb_t(0) / (limb_t)base) {
+        radix.chunk *= base;
+        ++radix.digits;
+    }
+    return radix;
+  }
+
+  static char digitChar(limb_t value)
+  {
+    return "0123456789abcdefghijklmnopqrstuvwxyz"[value];
+  }
+
+  // Value of a digit character in bases up to 36, 36 for anything that is not a digit
+  static int digitValue(char c)
+  {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+    return 36;
+  }
 
-        std::string q_str = to_string_rec(dm.first);
+  // Limb count from which toString splits with the cached Barrett reciprocal of the power of
+  // the base instead of dividing by it
+  enum { RADIX_BARRETT_LIMBS = 512 };
 
-        while (r_str.length() < k) {
-            r_str.insert(0, 1, '0');
+  // Up to this many chunks (or limbs) radix conversion runs the quadratic word-at-a-time
+  // loop instead of splitting by powers of the base
+  enum { RADIX_LINEAR_CHUNKS = 16 };
+
+  // Reads an optional sign and digits of radix.base into this value, which must be zero.
+  // Power-of-two bases are repacked bit by bit. Otherwise every chunk of digits becomes one
+  // limb, and neighbouring chunks are merged pairwise with the cached powers chunk^(2^i), so
+  // long inputs cost a few multiplications of the final size.
+  void parse(const char *str, size_t length, int base)
+  {
+    Radix radix = radixInfo(base);
+    size_t pos = 0;
+    bool is_neg = false;
+    if (length > 0 && (str[0] == '-' || str[0] == '+')) {
+        is_neg = (str[0] == '-');
+        pos = 1;
+    }
+    if (pos == length) {
+        if (length == 0) {
+            return;
         }
+        throw std::invalid_argument("No digits in BigInt string");
+    }
+    for (size_t i = pos; i < length; ++i) {
+        if (digitValue(str[i]) >= base) {
+            throw std::invalid_argument("Invalid digit in BigInt string");
+        }
+    }
 
-        return q_str + r_str;
-    };
+    const char *digits = str + pos;
+    size_t n = length - pos;
+    if (radix.bits) {
+        limbs.resize((n * radix.bits + LIMB_BITS - 1) / LIMB_BITS);
+        for (size_t i = 0; i < n; ++i) {
+            limb_t digit = (limb_t)digitValue(digits[n - 1 - i]);
+            size_t bit = i * radix.bits, idx = bit / LIMB_BITS, shift = bit % LIMB_BITS;
+            limbs[idx] |= digit << shift;
+            if (shift + radix.bits > LIMB_BITS) {
+                limbs[idx + 1] |= digit >> (LIMB_BITS - shift);
+            }
+        }
+        sign = is_neg;
+        trim();
+        return;
+    }
 
-    os << to_string_rec(bi.abs());
-    return os;
+    // Chunks of radix.digits digits, least significant first
+    size_t width = radix.digits;
+    std::vector<limb_t> chunks((n + width - 1) / width);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        size_t end = n - i * width;
+        size_t begin = end > width ? end - width : 0;
+        limb_t chunk = 0;
+        for (size_t k = begin; k < end; ++k) {
+            chunk = chunk * base + (limb_t)digitValue(digits[k]);
+        }
+        chunks[i] = chunk;
+    }
+
+    if (chunks.size() <= RADIX_LINEAR_CHUNKS) {
+        // Horner's rule, one pass over the limbs per chunk
+        limbs.reserve(chunks.size());
+        for (size_t i = chunks.size(); i-- > 0;) {
+            limb_t carry = chunks[i];
+            for (size_t j = 0; j < limbs.size(); ++j) {
+                dlimb_t t = (dlimb_t)limbs[j] * radix.chunk + carry;
+                limbs[j] = (limb_t)t;
+                carry = (limb_t)(t >> LIMB_BITS);
+            }
+            if (carry) {
+                limbs.push_back(carry);
+            }
+        }
+    } else {
+        // Level i joins pairs of values of 2^i chunks: high * chunk^(2^i) + low
+        std::vector<BigInt> parts(chunks.size());
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            if (chunks[i]) {
+                parts[i].limbs.push_back(chunks[i]);
+            }
+        }
+        for (size_t level = 0; parts.size() > 1; ++level) {
+            const BigInt &power = radixPower(radix, level);
+            size_t half = (parts.size() + 1) / 2;
+            for (size_t j = 0; j < half; ++j) {
+                if (2 * j + 1 < parts.size()) {
+                    parts[j] = parts[2 * j + 1] * power + parts[2 * j];
+                } else {
+                    parts[j] = std::move(parts[2 * j]);
+                }
+            }
+            parts.resize(half);
+        }
+        limbs = std::move(parts[0].limbs);
+    }
+
+    sign = is_neg;
+    trim();
+  }
+
+  // Writes |x| < chunk^(2^level) as exactly digits * 2^level digits to out, which is already
+  // filled with '0'
+  static void writeRadix(const BigInt &x, size_t level, char *out, const Radix &radix);
+
+  // Shared BarrettReducer for radixPower(radix, level)
+  static const BarrettReducer &radixReducer(const Radix &radix, size_t level);
+
+  // chunk^(2^level) of a base, computed by repeated squaring on first use and shared by all
+  // threads. A deque keeps references to earlier entries valid while a table grows.
+  static const BigInt &radixPower(const Radix &radix, size_t level)
+  {
+    static std::deque<BigInt> tables[37];
+    static std::mutex lock;
+    std::lock_guard<std::mutex> guard(lock);
+    std::deque<BigInt> &table = tables[radix.base];
+    if (table.empty()) {
+        table.push_back(BigInt());
+        table.back().limbs.push_back(radix.chunk);
+    }
+    while (table.size() <= level) {
+        table.push_back(table.back().square());
+    }
+    return table[level];
+  }
+
+  // Divisor limb count from which operator% caches a BarrettReducer for a reused divisor.
+  // Below it Algorithm D is faster than Barrett's two multiplications.
+  enum { BARRETT_THRESHOLD = 1024 };
+
+  // Sliding window width for an exponent of the given bit length, balancing the
+  // 2^(w-1) table multiplications against the roughly bits / (w + 1) window multiplications
+  static int windowBits(size_t exp_bits)
+  {
+    if (exp_bits > 671) return 6;
+    if (exp_bits > 239) return 5;
+    if (exp_bits > 79) return 4;
+    if (exp_bits > 23) return 3;
+    if (exp_bits > 5) return 2;
+    return 1;
+  }
+
+  // Left-to-right sliding window scan over the bits of |exp|. Calls square() once per
+  // exponent bit after the first window and multiply(idx, started) once per window, where
+  // idx indexes the odd power base^(2 * idx + 1). Until started is true the accumulator
+  // is still 1, so the callee can assign instead of multiplying.
+  template <class Square, class Multiply>
+  static void slidingWindowPow(const BigInt &exp, int window, Square square, Multiply multiply)
+  {
+    bool started = false;
+    size_t i = exp.bitLength();
+    while (i > 0) {
+        if (!exp.testBit(i - 1)) {
+            if (started) square();
+            --i;
+            continue;
+        }
+        // Widest window of at most `window` bits that ends in a set bit
+        size_t low = i > (size_t)window ? i - window : 0;
+        while (!exp.testBit(low)) {
+            ++low;
+        }
+        size_t value = 0;
+        for (size_t b = i; b-- > low;) {
+            value = (value << 1) | (exp.testBit(b) ? 1 : 0);
+        }
+        if (started) {
+            for (size_t b = low; b < i; ++b) {
+                square();
+            }
+        }
+        multiply(value >> 1, started);
+        started = true;
+        i = low;
+    }
+  }
+
+  static std::atomic<unsigned long long> &allocationCounter()
+  {
+    static std::atomic<unsigned long long> counter(0);
+    return counter;
+  }
+
+  // Vector-like limb storage with a small inline buffer. Magnitudes up to INLINE_LIMBS limbs
+  // live inside the object, larger ones spill to the heap with geometric growth.
+  class LimbVector
+  {
+  public:
+    enum { INLINE_LIMBS = 4 };
+
+    LimbVector() : ptr(buf), len(0), cap(INLINE_LIMBS) {}
+
+    LimbVector(const LimbVector &other) : ptr(buf), len(0), cap(INLINE_LIMBS)
+    {
+      assign(other.begin(), other.end());
+    }
+
+    LimbVector(LimbVector &&other) noexcept : ptr(buf), len(0), cap(INLINE_LIMBS)
+    {
+      steal(other);
+    }
+
+    ~LimbVector()
+    {
+      release();
+    }
+
+    LimbVector &operator=(const LimbVector &other)
+    {
+      if (&other != this) {
+          assign(other.begin(), other.end());
+      }
+      return *this;
+    }
+
+    LimbVector &operator=(LimbVector &&other) noexcept
+    {
+      if (&other != this) {
+          release();
+          steal(other);
+      }
+      return *this;
+    }
+
+    bool operator==(const LimbVector &other) const
+    {
+      return len == other.len && std::equal(ptr, ptr + len, other.ptr);
+    }
+
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    limb_t *data() { return ptr; }
+    const limb_t *data() const { return ptr; }
+    limb_t *begin() { return ptr; }
+    limb_t *end() { return ptr + len; }
+    const limb_t *begin() const { return ptr; }
+    const limb_t *end() const { return ptr + len; }
+    limb_t &operator[](size_t i) { return ptr[i]; }
+    const limb_t &operator[](size_t i) const { return ptr[i]; }
+    limb_t &back() { return ptr[len - 1]; }
+    const limb_t &back() const { return ptr[len - 1]; }
+
+    void clear() { len = 0; }
+    void pop_back() { --len; }
+
+    void push_back(limb_t value)
+    {
+      if (len == cap) {
+          grow(len + 1);
+      }
+      ptr[len++] = value;
+    }
+
+    void reserve(size_t n)
+    {
+      if (n > cap) {
+          grow(n);
+      }
+    }
+
+    void resize(size_t n, limb_t value = 0)
+    {
+      reserve(n);
+      if (n > len) {
+          std::fill(ptr + len, ptr + n, value);
+      }
+      len = n;
+    }
+
+    void assign(size_t n, limb_t value)
+    {
+      len = 0;
+      resize(n, value);
+    }
+
+    // Source range must not point into this vector
+    void assign(const limb_t *first, const limb_t *last)
+    {
+      size_t n = last - first;
+      len = 0;
+      reserve(n);
+      for (size_t i = 0; i < n; ++i) {
+          ptr[i] = first[i];
+      }
+      len = n;
+    }
+
+    void erase(limb_t *first, limb_t *last)
+    {
+      std::copy(last, ptr + len, first);
+      len -= last - first;
+    }
+
+    void insert(limb_t *pos, size_t n, limb_t value)
+    {
+      size_t offset = pos - ptr;
+      reserve(len + n);
+      std::copy_backward(ptr + offset, ptr + len, ptr + len + n);
+      std::fill(ptr + offset, ptr + offset + n, value);
+      len += n;
+    }
+
+  private:
+    void grow(size_t n)
+    {
+      n = std::max(n, cap * 2);
+      limb_t *fresh = new limb_t[n];
+      allocationCounter().fetch_add(1, std::memory_order_relaxed);
+      std::copy(ptr, ptr + len, fresh);
+      if (ptr != buf) {
+          delete[] ptr;
+      }
+      ptr = fresh;
+      cap = n;
+    }
+
+    void release()
+    {
+      if (ptr != buf) {
+          delete[] ptr;
+      }
+      ptr = buf;
+      len = 0;
+      cap = INLINE_LIMBS;
+    }
+
+    // Takes over the contents of other, which must be empty on the inline buffer afterwards
+    void steal(LimbVector &other)
+    {
+      if (other.ptr == other.buf) {
+          std::copy(other.buf, other.buf + other.len, buf);
+      } else {
+          ptr = other.ptr;
+          cap = other.cap;
+          other.ptr = other.buf;
+          other.cap = INLINE_LIMBS;
+      }
+      len = other.len;
+      other.len = 0;
+    }
+
+    limb_t *ptr;
+    size_t len;
+    size_t cap;
+    limb_t buf[INLINE_LIMBS];
+  };
+
+  // Compares two trimmed magnitudes, returns -1, 0 or 1
+  static int cmpN(const limb_t *a, size_t an, const limb_t *b, size_t bn)
+  {
+    if (an != bn) {
+        return an < bn ? -1 : 1;
+    }
+    for (size_t i = an; i-- > 0;) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+  }
+
+  // r = a + b where an >= bn, r has room for an limbs and may alias a or b. Returns the carry.
+  static limb_t addN(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn)
+  {
+    limb_t carry = 0;
+    size_t i = 0;
+    for (; i < bn; ++i) {
+        limb_t s = a[i] + carry;
+        carry = (s < carry);
+        limb_t t = s + b[i];
+        carry += (t < s);
+        r[i] = t;
+    }
+    for (; i < an; ++i) {
+        limb_t s = a[i] + carry;
+        carry = (s < carry);
+        r[i] = s;
+    }
+    return carry;
+  }
+
+  // r = a - b where an >= bn, r has room for an limbs and may alias a or b. Returns the borrow.
+  static limb_t subN(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn)
+  {
+    limb_t borrow = 0;
+    size_t i = 0;
+    for (; i < bn; ++i) {
+        limb_t ai = a[i];
+        limb_t d = ai - b[i];
+        limb_t borrow_out = (ai < b[i]);
+        borrow_out += (d < borrow);
+        r[i] = d - borrow;
+        borrow = borrow_out;
+    }
+    for (; i < an; ++i) {
+        limb_t ai = a[i];
+        r[i] = ai - borrow;
+        borrow = (ai < borrow);
+    }
+    return borrow;
+  }
+
+  // r += a * m over n limbs, returns the carry out of the top limb
+  static limb_t mulAdd1(limb_t *r, const limb_t *a, size_t n, limb_t m)
+  {
+    limb_t carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        dlimb_t t = (dlimb_t)a[i] * m + r[i] + carry;
+        r[i] = (limb_t)t;
+        carry = (limb_t)(t >> LIMB_BITS);
+    }
+    return carry;
+  }
+
+  // r -= a * m over n limbs, returns the borrow out of the top limb
+  static limb_t mulSub1(limb_t *r, const limb_t *a, size_t n, limb_t m)
+  {
+    limb_t borrow = 0;
+    for (size_t i = 0; i < n; ++i) {
+        dlimb_t p = (dlimb_t)a[i] * m + borrow;
+        limb_t lo = (limb_t)p;
+        borrow = (limb_t)(p >> LIMB_BITS);
+        limb_t ri = r[i];
+        r[i] = ri - lo;
+        borrow += (ri < lo);
+    }
+    return borrow;
+  }
+
+  // Schoolbook long division (Knuth, TAOCP vol. 2, 4.3.1 Algorithm D) of u by v, un >= vn and
+  // v[vn - 1] != 0. Writes un - vn + 1 quotient limbs to q and vn remainder limbs to r.
+  static void divmodN(limb_t *q, limb_t *r, const limb_t *u, size_t un, const limb_t *v, size_t vn)
+  {
+    if (vn == 1) {
+        limb_t rem = 0;
+        for (size_t i = un; i-- > 0;) {
+            dlimb_t cur = ((dlimb_t)rem << LIMB_BITS) | u[i];
+            q[i] = (limb_t)(cur / v[0]);
+            rem = (limb_t)(cur % v[0]);
+        }
+        r[0] = rem;
+        return;
+    }
+
+    // Normalize so the top divisor limb has its high bit set, the quotient digit estimate is
+    // then at most two too large
+    unsigned shift = __builtin_clzll(v[vn - 1]);
+    LimbVector vs, us;
+    vs.resize(vn);
+    us.resize(un + 1);
+    if (shift) {
+        lshiftN(vs.data(), v, vn, shift);
+        us[un] = lshiftN(us.data(), u, un, shift);
+    } else {
+        std::copy(v, v + vn, vs.data());
+        std::copy(u, u + un, us.data());
+        us[un] = 0;
+    }
+
+    const dlimb_t base = (dlimb_t)1 << LIMB_BITS;
+    limb_t v1 = vs[vn - 1], v2 = vs[vn - 2];
+    for (size_t j = un - vn + 1; j-- > 0;) {
+        dlimb_t num = ((dlimb_t)us[j + vn] << LIMB_BITS) | us[j + vn - 1];
+        dlimb_t qhat = num / v1;
+        dlimb_t rhat = num % v1;
+        if (qhat >= base) {
+            qhat = base - 1;
+            rhat = num - qhat * v1;
+        }
+        while (rhat < base && qhat * v2 > ((rhat << LIMB_BITS) | us[j + vn - 2])) {
+            --qhat;
+            rhat += v1;
+        }
+
+        // Multiply and subtract, add back once if the estimate was still one too large
+        limb_t borrow = mulSub1(us.data() + j, vs.data(), vn, (limb_t)qhat);
+        limb_t top = us[j + vn];
+        us[j + vn] = top - borrow;
+        if (top < borrow) {
+            --qhat;
+            us[j + vn] += addN(us.data() + j, us.data() + j, vn, vs.data(), vn);
+        }
+        q[j] = (limb_t)qhat;
+    }
+
+    if (shift) {
+        rshiftN(r, us.data(), vn, shift);
+        r[vn - 1] |= us[vn] << (LIMB_BITS - shift);
+    } else {
+        std::copy(us.data(), us.data() + vn, r);
+    }
+  }
+
+  // Bits [pos, pos + nbits) of the magnitude as a non-negative value
+  BigInt bitSlice(size_t pos, size_t nbits) const
+  {
+    BigInt result;
+    size_t first = pos / LIMB_BITS;
+    unsigned offset = pos % LIMB_BITS;
+    if (nbits == 0 || first >= limbs.size()) {
+        return result;
+    }
+    size_t count = (nbits + LIMB_BITS - 1) / LIMB_BITS;
+    size_t avail = std::min(limbs.size() - first, count + 1);
+    result.limbs.assign(limbs.begin() + first, limbs.begin() + first + avail);
+    if (offset) {
+        rshiftN(result.limbs.data(), result.limbs.data(), avail, offset);
+    }
+    if (result.limbs.size() >= count) {
+        result.limbs.resize(count);
+        if (nbits % LIMB_BITS) {
+            result.limbs[count - 1] &= (limb_t(1) << (nbits % LIMB_BITS)) - 1;
+        }
+    }
+    result.trim();
+    return result;
+  }
+
+  // Magnitude division a / b for a >= 0 and b > 0 by Algorithm D
+  static std::pair<BigInt, BigInt> divmodSchoolbook(const BigInt &a, const BigInt &b)
+  {
+    if (cmpN(a.limbs.data(), a.limbs.size(), b.limbs.data(), b.limbs.size()) < 0) {
+        return {BigInt(0), a};
+    }
+    BigInt quotient, remainder;
+    size_t n = b.limbs.size();
+    quotient.limbs.resize(a.limbs.size() - n + 1);
+    remainder.limbs.resize(n);
+    divmodN(quotient.limbs.data(), remainder.limbs.data(), a.limbs.data(), a.limbs.size(), b.limbs.data(), n);
+    quotient.trim();
+    remainder.trim();
+    return {std::move(quotient), std::move(remainder)};
+  }
+
+  // Recursive division (Burnikel and Ziegler, "Fast Recursive Division", 1998) of a < 2^n * b
+  // by b of exactly n bits. Each level does two 3n/2n divisions, which in turn split into a
+  // half size 2n/1n division and one n/2 x n/2 multiplication, so division costs a small
+  // multiple of multiplication.
+  static std::pair<BigInt, BigInt> div2n1n(BigInt a, BigInt b, size_t n)
+  {
+    if (a.bitLength() <= n + (size_t)BURNIKEL_ZIEGLER_THRESHOLD * LIMB_BITS) {
+        return divmodSchoolbook(a, b);
+    }
+    bool pad = n & 1;
+    if (pad) {
+        a <<= 1;
+        b <<= 1;
+        ++n;
+    }
+    size_t half = n / 2;
+    BigInt b1 = b >> (int)half;
+    BigInt b2 = b.bitSlice(0, half);
+    std::pair<BigInt, BigInt> upper = div3n2n(a >> (int)n, a.bitSlice(half, half), b, b1, b2, half);
+    std::pair<BigInt, BigInt> lower = div3n2n(upper.second, a.bitSlice(0, half), b, b1, b2, half);
+    if (pad) {
+        lower.second >>= 1;
+    }
+    return {(upper.first << (int)half) | lower.first, std::move(lower.second)};
+  }
+
+  // Divides a12 * 2^n + a3 by b = b1 * 2^n + b2, where b1 has exactly n bits and the quotient fits n bits
+  static std::pair<BigInt, BigInt> div3n2n(const BigInt &a12, const BigInt &a3, const BigInt &b,
+                                           const BigInt &b1, const BigInt &b2, size_t n)
+  {
+    std::pair<BigInt, BigInt> qr;
+    if ((a12 >> (int)n) == b1) {
+        qr.first = (BigInt(1) << (int)n) - 1;
+        qr.second = a12 - (b1 << (int)n) + b1;
+    } else {
+        qr = div2n1n(a12, b1, n);
+    }
+    qr.second = ((qr.second << (int)n) | a3) - qr.first * b2;
+    while (qr.second < 0) {
+        --qr.first;
+        qr.second += b;
+    }
+    return qr;
+  }
+
+  // Magnitude division a / b for a >= 0 and b > 0, long division in base 2^n with n the bit
+  // length of b, each digit step being one recursive 2n/1n division
+  static std::pair<BigInt, BigInt> divmodRecursive(const BigInt &a, const BigInt &b)
+  {
+    size_t n = b.bitLength();
+    size_t digits = (a.bitLength() + n - 1) / n;
+    BigInt quotient, remainder;
+    for (size_t i = digits; i-- > 0;) {
+        std::pair<BigInt, BigInt> qr = div2n1n((remainder << (int)n) | a.bitSlice(i * n, n), b, n);
+        if (qr.first) {
+            quotient += qr.first << (int)(i * n);
+        }
+        remainder = std::move(qr.second);
+    }
+    return {std::move(quotient), std::move(remainder)};
+  }
+
+  // Product of the magnitudes of two non-zero values by the algorithm suited to their size
+  static BigInt multiplyMagnitude(const BigInt &a, const BigInt &b)
+  {
+    size_t n = std::min(a.limbs.size(), b.limbs.size());
+    if (n >= nttThreshold()) {
+        return a.nttMultiply(b);
+    }
+    if (n >= toom3Threshold() && n >= 3) {
+        // Toom-3 splits by the longer operand, so a much shorter one would leave most of its
+        // parts zero. Unbalanced pairs are cut into balanced blocks first.
+        if (std::max(a.limbs.size(), b.limbs.size()) > 2 * n) {
+            return a.limbs.size() > b.limbs.size() ? multiplyBlocks(a, b) : multiplyBlocks(b, a);
+        }
+        return a.toom3Multiply(b);
+    }
+    return a.karatsubaMultiply(b);
+  }
+
+  // Product of the magnitudes for a longer than b: a is cut into blocks of b's length, like
+  // karatsubaMul does, and each block's product with b is added in at its offset
+  static BigInt multiplyBlocks(const BigInt &a, const BigInt &b)
+  {
+    size_t an = a.limbs.size(), bn = b.limbs.size();
+    BigInt result;
+    result.limbs.resize(an + bn);
+    BigInt block;
+    for (size_t offset = 0; offset < an; offset += bn) {
+        size_t length = std::min(bn, an - offset);
+        block.limbs.assign(a.limbs.data() + offset, a.limbs.data() + offset + length);
+        block.trim();
+        if (!block) {
+            continue;
+        }
+        BigInt product = multiplyMagnitude(block, b);
+        addN(result.limbs.data() + offset, result.limbs.data() + offset, an + bn - offset,
+             product.limbs.data(), product.limbs.size());
+    }
+    result.trim();
+    return result;
+  }
+
+  // Arithmetic modulo one NTT prime p = c * 2^50 + 1 < 2^62. Products use Montgomery reduction
+  // with R = 2^64: mul(a, b) = a * b * R^-1 mod p, so a factor kept in Montgomery form
+  // (b * R mod p) multiplies an ordinary residue exactly.
+  struct NttPrime
+  {
+    limb_t p;
+    limb_t generator; // primitive root modulo p
+    limb_t pinv;      // p^-1 mod 2^64
+    limb_t r2;        // R^2 mod p
+
+    limb_t add(limb_t a, limb_t b) const
+    {
+      limb_t sum = a + b;
+      return sum >= p ? sum - p : sum;
+    }
+
+    limb_t sub(limb_t a, limb_t b) const
+    {
+      return a >= b ? a - b : a + p - b;
+    }
+
+    // Requires a * b < p * 2^64, which holds whenever one factor is below p
+    limb_t mul(limb_t a, limb_t b) const
+    {
+      dlimb_t t = (dlimb_t)a * b;
+      limb_t q = (limb_t)t * pinv;
+      limb_t h = (limb_t)(((dlimb_t)q * p) >> LIMB_BITS);
+      limb_t hi = (limb_t)(t >> LIMB_BITS);
+      return hi >= h ? hi - h : hi + p - h;
+    }
+
+    // base^exp with base and result in Montgomery form
+    limb_t pow(limb_t base, limb_t exp) const
+    {
+      limb_t result = mul(1, r2);
+      while (exp) {
+          if (exp & 1) result = mul(result, base);
+          base = mul(base, base);
+          exp >>= 1;
+      }
+      return result;
+    }
+
+    // Powers w^j and w^-j for j < n / 2 of a primitive n-th root of unity w, in Montgomery form.
+    // Such a root exists only if n divides p - 1.
+    void roots(size_t n, std::vector<limb_t> &forward, std::vector<limb_t> &inverse) const
+    {
+      assert((p - 1) % n == 0);
+      limb_t w = pow(mul(generator, r2), (p - 1) / n);
+      limb_t w_inv = pow(w, n - 1);
+      forward.resize(n / 2);
+      inverse.resize(n / 2);
+      limb_t one = mul(1, r2);
+      for (size_t j = 0; j < n / 2; ++j) {
+          forward[j] = j ? mul(forward[j - 1], w) : one;
+          inverse[j] = j ? mul(inverse[j - 1], w_inv) : one;
+      }
+    }
+  };
+
+  static NttPrime makeNttPrime(limb_t p, limb_t generator)
+  {
+    NttPrime prime;
+    prime.p = p;
+    prime.generator = generator;
+    limb_t inv = p;
+    for (int i = 0; i < 5; ++i) {
+        inv *= 2 - p * inv;
+    }
+    prime.pinv = inv;
+    limb_t r = (limb_t)(((dlimb_t)1 << LIMB_BITS) % p);
+    prime.r2 = (limb_t)((dlimb_t)r * r % p);
+    return prime;
+  }
+
+  static const NttPrime *nttPrimes()
+  {
+    static const NttPrime primes[3] = {
+        makeNttPrime(0x3fdc000000000001ULL, 3),  // 4087 * 2^50 + 1
+        makeNttPrime(0x3f18000000000001ULL, 10), // 4038 * 2^50 + 1
+        makeNttPrime(0x3ec4000000000001ULL, 37)  // 4017 * 2^50 + 1
+    };
+    return primes;
+  }
+
+  // Garner constants for the three primes, the modular ones in Montgomery form
+  struct NttCrt
+  {
+    limb_t inv_p1_mod_p2;
+    limb_t p1_mod_p3;
+    limb_t inv_p1p2_mod_p3;
+    dlimb_t p1p2;
+  };
+
+  static const NttCrt &nttCrt()
+  {
+    static const NttCrt crt = []() {
+        const NttPrime *primes = nttPrimes();
+        const NttPrime &P1 = primes[0], &P2 = primes[1], &P3 = primes[2];
+        // Inverses by Fermat, a^(p - 2) in Montgomery form is already the wanted R-scaled value
+        NttCrt c;
+        c.inv_p1_mod_p2 = P2.pow(P2.mul(P1.p % P2.p, P2.r2), P2.p - 2);
+        c.p1_mod_p3 = P3.mul(P1.p % P3.p, P3.r2);
+        limb_t p1p2_mod_p3 = P3.mul(c.p1_mod_p3, P2.p % P3.p);
+        c.inv_p1p2_mod_p3 = P3.pow(P3.mul(p1p2_mod_p3, P3.r2), P3.p - 2);
+        c.p1p2 = (dlimb_t)P1.p * P2.p;
+        return c;
+    }();
+    return crt;
+  }
+
+  // In-place decimation in frequency transform of length n, natural order in and bit reversed
+  // order out. roots[j] = w^j for a primitive n-th root of unity w, in Montgomery form.
+  static void nttForward(limb_t *a, size_t n, const NttPrime &P, const limb_t *roots)
+  {
+    for (size_t len = n / 2, stride = 1; len >= 1; len >>= 1, stride <<= 1) {
+        for (size_t i = 0; i < n; i += 2 * len) {
+            for (size_t j = 0; j < len; ++j) {
+                limb_t u = a[i + j], v = a[i + j + len];
+                a[i + j] = P.add(u, v);
+                a[i + j + len] = P.mul(P.sub(u, v), roots[j * stride]);
+            }
+        }
+    }
+  }
+
+  // Inverse of nttForward up to a factor of n: decimation in time over the inverse roots,
+  // bit reversed order in and natural order out
+  static void nttInverse(limb_t *a, size_t n, const NttPrime &P, const limb_t *roots)
+  {
+    for (size_t len = 1, stride = n / 2; len < n; len <<= 1, stride >>= 1) {
+        for (size_t i = 0; i < n; i += 2 * len) {
+            for (size_t j = 0; j < len; ++j) {
+                limb_t u = a[i + j], v = P.mul(a[i + j + len], roots[j * stride]);
+                a[i + j] = P.add(u, v);
+                a[i + j + len] = P.sub(u, v);
+            }
+        }
+    }
+  }
+
+  // Schoolbook product, r must hold an + bn limbs and must not alias a or b
+  static void mulBasecase(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn)
+  {
+    std::fill(r, r + an + bn, limb_t(0));
+    for (size_t j = 0; j < bn; ++j) {
+        r[an + j] = mulAdd1(r + j, a, an, b[j]);
+    }
+  }
+
+  // Schoolbook square, r must hold 2n limbs and must not alias a. The cross products
+  // a[i] * a[j] with i < j are summed once and doubled, then the diagonal a[i]^2 is added.
+  static void sqrBasecase(limb_t *r, const limb_t *a, size_t n)
+  {
+    std::fill(r, r + 2 * n, limb_t(0));
+    for (size_t i = 0; i + 1 < n; ++i) {
+        r[n + i] = mulAdd1(r + 2 * i + 1, a + i + 1, n - i - 1, a[i]);
+    }
+    lshiftN(r, r, 2 * n, 1);
+
+    limb_t carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        dlimb_t sq = (dlimb_t)a[i] * a[i];
+        dlimb_t low = (dlimb_t)r[2 * i] + (limb_t)sq + carry;
+        r[2 * i] = (limb_t)low;
+        dlimb_t high = (dlimb_t)r[2 * i + 1] + (limb_t)(sq >> LIMB_BITS) + (limb_t)(low >> LIMB_BITS);
+        r[2 * i + 1] = (limb_t)high;
+        carry = (limb_t)(high >> LIMB_BITS);
+    }
+  }
+
+  // *this += a * b, or -= when subtract is set. Operands below the Karatsuba threshold are
+  // multiplied straight into the accumulator with mulAdd1 / mulSub1, a result that crosses
+  // zero is brought back from its two's complement at the end.
+  BigInt &addMulSigned(const BigInt &a, const BigInt &b, bool subtract)
+  {
+    if (!a || !b) {
+        return *this;
+    }
+    bool product_sign = (a.sign != b.sign) != subtract;
+    const BigInt &x = a.limbs.size() >= b.limbs.size() ? a : b;
+    const BigInt &y = a.limbs.size() >= b.limbs.size() ? b : a;
+    size_t xn = x.limbs.size(), yn = y.limbs.size();
+    if (&a == this || &b == this || yn >= karatsubaThreshold()) {
+        BigInt product = a.multiply(b);
+        return addSigned(product, product_sign);
+    }
+
+    if (limbs.empty()) {
+        sign = product_sign;
+    }
+    size_t n = std::max(limbs.size(), xn + yn) + 1;
+    limbs.resize(n, 0);
+    limb_t *r = limbs.data();
+    const limb_t *xp = x.limbs.data(), *yp = y.limbs.data();
+    if (sign == product_sign) {
+        for (size_t j = 0; j < yn; ++j) {
+            limb_t carry = mulAdd1(r + j, xp, xn, yp[j]);
+            addN(r + j + xn, r + j + xn, n - j - xn, &carry, 1);
+        }
+    } else {
+        limb_t wrapped = 0;
+        for (size_t j = 0; j < yn; ++j) {
+            limb_t borrow = mulSub1(r + j, xp, xn, yp[j]);
+            wrapped |= subN(r + j + xn, r + j + xn, n - j - xn, &borrow, 1);
+        }
+        if (wrapped) { // |a * b| exceeded the magnitude, negate the n-limb two's complement
+            limb_t one = 1;
+            for (size_t i = 0; i < n; ++i) {
+                r[i] = ~r[i];
+            }
+            addN(r, r, n, &one, 1);
+            sign = !sign;
+        }
+    }
+    trim();
+    return *this;
+  }
+
+  // Whether the subproducts of an n-limb product are worth handing to helper threads
+  static bool parallelProduct(size_t n)
+  {
+    return multiplyThreads() > 1 && n >= parallelMultiplyThreshold();
+  }
+
+  // Helper threads running product tasks right now, over all multiplications
+  static std::atomic<unsigned> &busyMultiplyHelpers()
+  {
+    static std::atomic<unsigned> busy(0);
+    return busy;
+  }
+
+  static bool acquireMultiplyHelper()
+  {
+    std::atomic<unsigned> &busy = busyMultiplyHelpers();
+    unsigned current = busy.load();
+    while (current + 1 < multiplyThreads()) {
+        if (busy.compare_exchange_weak(current, current + 1)) {
+            return true;
+        }
+    }
+    return false;
+  }
+
+  // Runs the independent subproducts of an n-limb product. When parallelProduct(n) holds,
+  // every task but the last starts on a helper thread as long as the multiplyThreads() cap
+  // has room, the others run on the calling thread, which then waits for the helpers. The
+  // first exception of any task is rethrown.
+  static void runProducts(std::function<void()> *tasks, size_t count, size_t n)
+  {
+    if (!parallelProduct(n)) {
+        for (size_t i = 0; i < count; ++i) {
+            tasks[i]();
+        }
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(count);
+    auto run = [&](size_t i) {
+        try {
+            tasks[i]();
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> helpers;
+    std::vector<bool> started(count, false);
+    for (size_t i = 0; i + 1 < count && acquireMultiplyHelper(); ++i) {
+        try {
+            helpers.emplace_back([&run, i] {
+                run(i);
+                busyMultiplyHelpers()--;
+            });
+            started[i] = true;
+        } catch (const std::system_error &) {
+            busyMultiplyHelpers()--;
+            break;
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (!started[i]) {
+            run(i);
+        }
+    }
+    for (std::thread &helper : helpers) {
+        helper.join();
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (errors[i]) {
+            std::rethrow_exception(errors[i]);
+        }
+    }
+  }
+
+  // r = |a - b| for an >= bn, r has room for an limbs. Returns true when a < b.
+  static bool absDiffN(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn)
+  {
+    size_t top = an;
+    while (top > bn && a[top - 1] == 0) {
+        --top;
+    }
+    if (top > bn || cmpN(a, bn, b, bn) >= 0) {
+        subN(r, a, an, b, bn);
+        return false;
+    }
+    subN(r, b, bn, a, bn);
+    std::fill(r + bn, r + an, limb_t(0));
+    return true;
+  }
+
+  // Scratch limbs used by karatsubaN and karatsubaSqrN on n-limb operands: each level keeps
+  // |a0 - a1|, |b0 - b1| and their product, then reuses the space of its children for the
+  // middle coefficient
+  static size_t karatsubaScratchN(size_t n)
+  {
+    if (n < std::max(karatsubaThreshold(), (size_t)2)) {
+        return 0;
+    }
+    size_t l = (n + 1) / 2;
+    return 4 * l + std::max(karatsubaScratchN(l), 2 * l + 1);
+  }
+
+  // Scratch limbs used by karatsubaMul, an >= bn
+  static size_t karatsubaScratch(size_t an, size_t bn)
+  {
+    if (bn < std::max(karatsubaThreshold(), (size_t)2)) {
+        return 0;
+    }
+    if (an == bn) {
+        return karatsubaScratchN(bn);
+    }
+    size_t tail = an % bn;
+    return 2 * bn + std::max(karatsubaScratchN(bn), tail ? karatsubaScratch(bn, tail) : 0);
+  }
+
+  // Adds the middle Karatsuba coefficient z0 + z2 - t (or + t when subtract is false) into
+  // r at limb l, where z0 = r[0, 2l) and z2 = r[2l, 2n) already hold the outer products
+  static void karatsubaCombine(limb_t *r, size_t n, size_t l, const limb_t *t, bool subtract, limb_t *mid)
+  {
+    size_t h = n - l;
+    mid[2 * l] = addN(mid, r, 2 * l, r + 2 * l, 2 * h);
+    if (subtract) {
+        mid[2 * l] -= subN(mid, mid, 2 * l, t, 2 * l);
+    } else {
+        mid[2 * l] += addN(mid, mid, 2 * l, t, 2 * l);
+    }
+    // The coefficient is below 2^(64(n + h)), limbs past the end of r are zero
+    size_t mn = std::min(2 * l + 1, 2 * n - l);
+    addN(r + l, r + l, 2 * n - l, mid, mn);
+  }
+
+  // r = a * b on n-limb operands with a = a0 + a1 * 2^(64l), l = ceil(n / 2), using
+  // a0 * b1 + a1 * b0 = z0 + z2 - (a0 - a1)(b0 - b1). r holds 2n limbs and must not alias
+  // a or b, w is scratch of karatsubaScratchN(n) limbs.
+  static void karatsubaN(limb_t *r, const limb_t *a, const limb_t *b, size_t n, limb_t *w)
+  {
+    if (n < std::max(karatsubaThreshold(), (size_t)2)) {
+        mulBasecase(r, a, n, b, n);
+        return;
+    }
+    size_t l = (n + 1) / 2, h = n - l;
+    limb_t *da = w, *db = w + l, *t = w + 2 * l, *next = w + 4 * l;
+    bool negative = absDiffN(da, a, l, a + l, h) != absDiffN(db, b, l, b + l, h);
+    if (parallelProduct(n)) {
+        // Two of the three products get scratch of their own so that they can run at once
+        LimbVector w1, w2;
+        w1.resize(karatsubaScratchN(l));
+        w2.resize(karatsubaScratchN(l));
+        std::function<void()> products[3] = {
+            [&] { karatsubaN(t, da, db, l, w1.data()); },
+            [&] { karatsubaN(r + 2 * l, a + l, b + l, h, w2.data()); },
+            [&] { karatsubaN(r, a, b, l, next); }};
+        runProducts(products, 3, n);
+    } else {
+        karatsubaN(t, da, db, l, next);
+        karatsubaN(r, a, b, l, next);
+        karatsubaN(r + 2 * l, a + l, b + l, h, next);
+    }
+    karatsubaCombine(r, n, l, t, !negative, next);
+  }
+
+  // r = a^2 on n limbs, the same split as karatsubaN with three half size squares
+  static void karatsubaSqrN(limb_t *r, const limb_t *a, size_t n, limb_t *w)
+  {
+    if (n < std::max(karatsubaThreshold(), (size_t)2)) {
+        sqrBasecase(r, a, n);
+        return;
+    }
+    size_t l = (n + 1) / 2, h = n - l;
+    limb_t *da = w, *t = w + 2 * l, *next = w + 4 * l;
+    absDiffN(da, a, l, a + l, h);
+    if (parallelProduct(n)) {
+        LimbVector w1, w2;
+        w1.resize(karatsubaScratchN(l));
+        w2.resize(karatsubaScratchN(l));
+        std::function<void()> products[3] = {
+            [&] { karatsubaSqrN(t, da, l, w1.data()); },
+            [&] { karatsubaSqrN(r + 2 * l, a + l, h, w2.data()); },
+            [&] { karatsubaSqrN(r, a, l, next); }};
+        runProducts(products, 3, n);
+    } else {
+        karatsubaSqrN(t, da, l, next);
+        karatsubaSqrN(r, a, l, next);
+        karatsubaSqrN(r + 2 * l, a + l, h, next);
+    }
+    karatsubaCombine(r, n, l, t, true, next);
+  }
+
+  // r = a * b for an >= bn, a is cut into bn-limb blocks that are each multiplied by b with
+  // karatsubaN. r holds an + bn limbs and must not alias a or b, w is scratch of
+  // karatsubaScratch(an, bn) limbs.
+  static void karatsubaMul(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn, limb_t *w)
+  {
+    if (bn < std::max(karatsubaThreshold(), (size_t)2)) {
+        mulBasecase(r, a, an, b, bn);
+        return;
+    }
+    if (an == bn) {
+        karatsubaN(r, a, b, bn, w);
+        return;
+    }
+
+    limb_t *block = w, *next = w + 2 * bn;
+    karatsubaN(r, a, b, bn, next);
+    std::fill(r + 2 * bn, r + an + bn, limb_t(0));
+    size_t offset = bn;
+    for (; offset + bn <= an; offset += bn) {
+        karatsubaN(block, a + offset, b, bn, next);
+        addN(r + offset, r + offset, an + bn - offset, block, 2 * bn);
+    }
+    if (offset < an) {
+        size_t tail = an - offset;
+        karatsubaMul(block, b, bn, a + offset, tail, next);
+        addN(r + offset, r + offset, an + bn - offset, block, bn + tail);
+    }
+  }
+
+  // r = a << cnt for 0 < cnt < LIMB_BITS, r may alias a. Returns the bits shifted out.
+  static limb_t lshiftN(limb_t *r, const limb_t *a, size_t n, unsigned cnt)
+  {
+    limb_t out = 0;
+    for (size_t i = n; i-- > 0;) {
+        limb_t ai = a[i];
+        if (i + 1 == n) {
+            out = ai >> (LIMB_BITS - cnt);
+        }
+        r[i] = (ai << cnt) | (i > 0 ? a[i - 1] >> (LIMB_BITS - cnt) : 0);
+    }
+    return out;
+  }
+
+  // r = a >> cnt for 0 < cnt < LIMB_BITS, r may alias a. Returns the bits shifted out, left aligned.
+  static limb_t rshiftN(limb_t *r, const limb_t *a, size_t n, unsigned cnt)
+  {
+    limb_t out = n ? a[0] << (LIMB_BITS - cnt) : 0;
+    for (size_t i = 0; i < n; ++i) {
+        limb_t high = (i + 1 < n) ? a[i + 1] << (LIMB_BITS - cnt) : 0;
+        r[i] = (a[i] >> cnt) | high;
+    }
+    return out;
+  }
+
+  bool sign = false; // false = positive, true = negative
+  LimbVector limbs; // magnitude in 64-bit limbs, least significant first, no leading zero limbs
+};
+
+// std::vector<BigInt> only moves its elements on reallocation when this holds, otherwise
+// every growth copies each value
+static_assert(std::is_nothrow_move_constructible<BigInt>::value, "BigInt moves must not throw");
+
+// Follows the stream's basefield (std::dec, std::hex or std::oct), std::showbase and
+// std::uppercase
+inline std::ostream &operator<<(std::ostream &os, const BigInt &bi)
+{
+    std::ios_base::fmtflags flags = os.flags();
+    std::ios_base::fmtflags basefield = flags & std::ios_base::basefield;
+    int base = basefield == std::ios_base::hex ? 16 : basefield == std::ios_base::oct ? 8 : 10;
+
+    std::string text = bi.toString(base);
+    if (flags & std::ios_base::uppercase) {
+        std::transform(text.begin(), text.end(), text.begin(), ::toupper);
+    }
+    if ((flags & std::ios_base::showbase) && base != 10 && bi) {
+        const char *prefix = base == 8 ? "0" : (flags & std::ios_base::uppercase) ? "0X" : "0x";
+        text.insert(bi.sign ? 1 : 0, prefix);
+    }
+    os << text;
+    return os;
+}
+
+// Montgomery arithmetic modulo a fixed odd modulus n with R = 2^(64 * limbs of n).
+// Values in Montgomery form are a * R mod n, products are reduced with CIOS
+// interleaved multiplication and reduction, so no division is needed per operation.
+class MontgomeryContext
+{
+public:
+  typedef BigInt::limb_t limb_t;
+  typedef BigInt::dlimb_t dlimb_t;
+
+  explicit MontgomeryContext(const BigInt &modulus) : n(modulus.abs())
+  {
+    if (n <= 1 || n.isEven()) {
+      throw std::invalid_argument("Montgomery modulus must be odd and greater than one");
+    }
+    s = n.limbs.size();
+
+    // Newton iteration for n^-1 mod 2^64, each step doubles the number of correct bits
+    limb_t n0 = n.limbs[0];
+    limb_t inv = n0;
+    for (int i = 0; i < 5; ++i) {
+        inv *= 2 - n0 * inv;
+    }
+    n0inv = 0 - inv;
+
+    BigInt r = BigInt(1) << (int)(s * BigInt::LIMB_BITS);
+    r_mod = r % n;
+    r2 = BigInt::mulMod(r_mod, r_mod, n);
+  }
+
+  const BigInt &modulus() const
+  {
+    return n;
+  }
+
+  // Montgomery form of 1
+  const BigInt &one() const
+  {
+    return r_mod;
+  }
+
+  BigInt toMontgomery(const BigInt &a) const
+  {
+    return multiply(reduce(a), r2);
+  }
+
+  BigInt fromMontgomery(const BigInt &a) const
+  {
+    return multiply(a, BigInt(1));
+  }
+
+  // a * b * R^-1 mod n, both operands must be in [0, n). Only the result is allocated.
+  BigInt multiply(const BigInt &a, const BigInt &b) const
+  {
+    limb_t *t = threadScratch(scratchSize() + 2 * s);
+    const limb_t *pa = padded(a, t + scratchSize());
+    const limb_t *pb = padded(b, t + scratchSize() + s);
+    BigInt result;
+    result.limbs.resize(s);
+    mulRaw(result.limbs.data(), pa, pb, t);
+    result.trim();
+    return result;
+  }
+
+  // a^2 * R^-1 mod n, cheaper than multiply(a, a): the square costs about half of a product
+  BigInt square(const BigInt &a) const
+  {
+    limb_t *t = threadScratch(scratchSize() + s);
+    const limb_t *pa = padded(a, t + scratchSize());
+    BigInt result;
+    result.limbs.resize(s);
+    sqrRaw(result.limbs.data(), pa, t);
+    result.trim();
+    return result;
+  }
+
+  // Odd powers base, base^3, ..., base^(2^window - 1) in Montgomery form. Building it costs
+  // 2^(window - 1) multiplications, so a base that is raised to many exponents can keep one.
+  struct PowTable
+  {
+    int window;
+    std::vector<std::vector<limb_t> > powers;
+  };
+
+  PowTable precompute(const BigInt &base, int window) const
+  {
+    if (window < 1 || window > 16) {
+      throw std::invalid_argument("Window size must be between 1 and 16");
+    }
+    PowTable table;
+    table.window = window;
+    table.powers.resize(size_t(1) << (window - 1));
+    table.powers[0] = pad(base);
+    if (window > 1) {
+        std::vector<limb_t> sq(s), t(scratchSize());
+        sqrRaw(sq.data(), table.powers[0].data(), t.data());
+        for (size_t i = 1; i < table.powers.size(); ++i) {
+            table.powers[i].resize(s);
+            mulRaw(table.powers[i].data(), table.powers[i - 1].data(), sq.data(), t.data());
+        }
+    }
+    return table;
+  }
+
+  // base^exp with base and result in Montgomery form, window picked from the exponent size
+  BigInt montPow(const BigInt &base, const BigInt &exp) const
+  {
+    return montPow(precompute(base, BigInt::windowBits(exp.bitLength())), exp);
+  }
+
+  BigInt montPow(const PowTable &table, const BigInt &exp) const
+  {
+    std::vector<limb_t> acc = pad(r_mod), t(scratchSize());
+    limb_t *a = acc.data();
+    limb_t *scratch = t.data();
+    BigInt::slidingWindowPow(exp, table.window,
+        [&]() { sqrRaw(a, a, scratch); },
+        [&](size_t idx, bool started) {
+            const limb_t *p = table.powers[idx].data();
+            if (started) {
+                mulRaw(a, a, p, scratch);
+            } else {
+                std::copy(p, p + s, a);
+            }
+        });
+    BigInt result;
+    result.limbs.assign(a, a + s);
+    result.trim();
+    return result;
+  }
+
+  // base^exp mod n in the ordinary representation, exp must be non-negative
+  BigInt pow(const BigInt &base, const BigInt &exp) const
+  {
+    return fromMontgomery(montPow(toMontgomery(base), exp));
+  }
+
+private:
+  // Reduces any value into [0, n)
+  BigInt reduce(const BigInt &a) const
+  {
+    if (!a.sign && a < n) {
+        return a;
+    }
+    BigInt r = a % n;
+    if (r.sign) {
+        r += n;
+    }
+    return r;
+  }
+
+  std::vector<limb_t> pad(const BigInt &a) const
+  {
+    std::vector<limb_t> out(s, 0);
+    std::copy(a.limbs.begin(), a.limbs.end(), out.begin());
+    return out;
+  }
+
+  // The limbs of a as s limbs, either a's own or a zero padded copy in out
+  const limb_t *padded(const BigInt &a, limb_t *out) const
+  {
+    if (a.limbs.size() == s) {
+        return a.limbs.data();
+    }
+    std::fill(std::copy(a.limbs.begin(), a.limbs.end(), out), out + s, limb_t(0));
+    return out;
+  }
+
+  // Scratch of at least size limbs for multiply and square, kept per thread because one
+  // context is shared by the Miller-Rabin workers. It grows to the largest modulus used.
+  static limb_t *threadScratch(size_t size)
+  {
+    static thread_local std::vector<limb_t> scratch;
+    if (scratch.size() < size) {
+        scratch.resize(size);
+    }
+    return scratch.data();
+  }
+
+  // Limbs of scratch space needed by mulRaw and sqrRaw
+  size_t scratchSize() const
+  {
+    return 2 * s + 1;
+  }
+
+  // r = a^2 * R^-1 mod n on an s-limb operand below n: a full schoolbook square followed by
+  // a separate reduction of its 2s limbs. t is scratch of 2s + 1 limbs, r may alias a.
+  void sqrRaw(limb_t *r, const limb_t *a, limb_t *t) const
+  {
+    const limb_t *m = n.limbs.data();
+    BigInt::sqrBasecase(t, a, s);
+    t[2 * s] = 0;
+    for (size_t i = 0; i < s; ++i) {
+        // Add q * n * 2^(64i) so limb i becomes zero
+        limb_t q = t[i] * n0inv;
+        limb_t c = BigInt::mulAdd1(t + i, m, s, q);
+        for (size_t j = i + s; c; ++j) {
+            t[j] += c;
+            c = t[j] < c;
+        }
+    }
+    // Result is below 2n, one conditional subtraction brings it into [0, n)
+    limb_t *hi = t + s;
+    if (hi[s] || BigInt::cmpN(hi, s, m, s) >= 0) {
+        BigInt::subN(r, hi, s, m, s);
+    } else {
+        std::copy(hi, hi + s, r);
+    }
+  }
+
+  // r = a * b * R^-1 mod n on s-limb operands below n using CIOS.
+  // t is scratch of at least s + 2 limbs, r may alias a or b.
+  void mulRaw(limb_t *r, const limb_t *a, const limb_t *b, limb_t *t) const
+  {
+    const limb_t *m = n.limbs.data();
+    std::fill(t, t + s + 2, limb_t(0));
+    for (size_t i = 0; i < s; ++i) {
+        limb_t c = BigInt::mulAdd1(t, a, s, b[i]);
+        dlimb_t top = (dlimb_t)t[s] + c;
+        t[s] = (limb_t)top;
+        t[s + 1] = (limb_t)(top >> BigInt::LIMB_BITS);
+
+        // Add q * n so the lowest limb becomes zero and shift it out
+        limb_t q = t[0] * n0inv;
+        dlimb_t acc = (dlimb_t)q * m[0] + t[0];
+        c = (limb_t)(acc >> BigInt::LIMB_BITS);
+        for (size_t j = 1; j < s; ++j) {
+            acc = (dlimb_t)q * m[j] + t[j] + c;
+            t[j - 1] = (limb_t)acc;
+            c = (limb_t)(acc >> BigInt::LIMB_BITS);
+        }
+        top = (dlimb_t)t[s] + c;
+        t[s - 1] = (limb_t)top;
+        t[s] = t[s + 1] + (limb_t)(top >> BigInt::LIMB_BITS);
+    }
+    // Result is below 2n, one conditional subtraction brings it into [0, n)
+    if (t[s] || BigInt::cmpN(t, s, m, s) >= 0) {
+        BigInt::subN(r, t, s, m, s);
+    } else {
+        std::copy(t, t + s, r);
+    }
+  }
+
+  BigInt n;
+  size_t s;      // limb count of n
+  limb_t n0inv;  // -n^-1 mod 2^64
+  BigInt r_mod;  // R mod n
+  BigInt r2;     // R^2 mod n
+};
+
+// Barrett reduction modulo a fixed m of k limbs. The reciprocal mu = floor(2^(128k) / m)
+// is computed once, after which any value below 2^(128k) is reduced with two
+// multiplications and at most two corrective subtractions.
+class BarrettReducer
+{
+public:
+  explicit BarrettReducer(const BigInt &modulus) : m(modulus.abs())
+  {
+    if (m == 0) {
+      throw std::invalid_argument("Division by zero");
+    }
+    k = m.limbs.size();
+    mu = (BigInt(1) << (int)(2 * k * BigInt::LIMB_BITS)) / m;
+  }
+
+  const BigInt &modulus() const
+  {
+    return m;
+  }
+
+  // x % m with the sign convention of operator%, the remainder takes the sign of x
+  BigInt reduce(const BigInt &x) const
+  {
+    return divmod(x).second;
+  }
+
+  // Quotient and remainder with the sign convention of BigInt::divmod
+  std::pair<BigInt, BigInt> divmod(const BigInt &x) const
+  {
+    if (x.limbs.size() > 2 * k) {
+        return x.divmod(m);
+    }
+    BigInt r = x.abs();
+    if (r < m) {
+        return {BigInt(0), x};
+    }
+
+    int limb_bits = BigInt::LIMB_BITS;
+    BigInt q = ((r >> ((int)(k - 1) * limb_bits)) * mu) >> ((int)(k + 1) * limb_bits);
+    r.subMul(q, m);
+    while (r >= m) {
+        r -= m;
+        q += 1;
+    }
+
+    if (x.sign) {
+        q = -std::move(q);
+        r = -std::move(r);
+    }
+    return {std::move(q), std::move(r)};
+  }
+
+  BigInt multiply(const BigInt &a, const BigInt &b) const
+  {
+    return reduce(a * b);
+  }
+
+private:
+  BigInt m;
+  size_t k;  // limb count of m
+  BigInt mu; // floor(2^(128k) / m)
+};
+
+// Large values are split at chunk^(2^(level - 1)) into two halves, small ones are converted
+// by repeated division by the chunk, one chunk of digits per pass over the limbs.
+inline void BigInt::writeRadix(const BigInt &x, size_t level, char *out, const Radix &radix)
+{
+    if (!x) {
+        return;
+    }
+    size_t n = x.limbs.size();
+    if (level == 0 || n <= RADIX_LINEAR_CHUNKS) {
+        std::vector<limb_t> q(x.limbs.begin(), x.limbs.end());
+        char *end = out + (size_t(radix.digits) << level);
+        while (n > 0) {
+            limb_t rem = 0;
+            for (size_t i = n; i-- > 0;) {
+                dlimb_t cur = ((dlimb_t)rem << LIMB_BITS) | q[i];
+                q[i] = (limb_t)(cur / radix.chunk);
+                rem = (limb_t)(cur % radix.chunk);
+            }
+            while (n > 0 && q[n - 1] == 0) {
+                --n;
+            }
+            for (int k = 0; k < radix.digits && rem; ++k) {
+                end[-1 - k] = digitChar(rem % radix.base);
+                rem /= radix.base;
+            }
+            end -= radix.digits;
+        }
+        return;
+    }
+
+    std::pair<BigInt, BigInt> qr = n >= RADIX_BARRETT_LIMBS ? radixReducer(radix, level - 1).divmod(x)
+                                                          : x.divmod(radixPower(radix, level - 1));
+    writeRadix(qr.first, level - 1, out, radix);
+    writeRadix(qr.second, level - 1, out + (size_t(radix.digits) << (level - 1)), radix);
+}
+
+inline const BarrettReducer &BigInt::radixReducer(const Radix &radix, size_t level)
+{
+    static std::deque<BarrettReducer> reducers[37];
+    static std::mutex lock;
+    std::lock_guard<std::mutex> guard(lock);
+    std::deque<BarrettReducer> &table = reducers[radix.base];
+    while (table.size() <= level) {
+        table.emplace_back(radixPower(radix, table.size()));
+    }
+    return table[level];
+}
+
+inline BigInt BigInt::operator%(const BigInt &divisor) const
+{
+    if (divisor.limbs.size() < BARRETT_THRESHOLD || limbs.size() > 2 * divisor.limbs.size()) {
+        return divmod(divisor).second;
+    }
+
+    // Per thread memory of the last divisor, the reducer is built when it comes back
+    struct Cache
+    {
+      BigInt last;
+      std::unique_ptr<BarrettReducer> reducer;
+    };
+    static thread_local Cache cache;
+
+    if (cache.reducer && cache.reducer->modulus().limbs == divisor.limbs) {
+        return cache.reducer->reduce(*this);
+    }
+    if (cache.last.limbs == divisor.limbs) {
+        cache.reducer.reset(new BarrettReducer(divisor));
+        return cache.reducer->reduce(*this);
+    }
+    cache.last = divisor;
+    return divmod(divisor).second;
+}
+
+#ifdef FBIGINT_EXPRESSION_TEMPLATES
+inline BigInt &BigInt::operator+=(const Product &rhs)
+{
+    return addMul(rhs.a, rhs.b);
+}
+
+inline BigInt &BigInt::operator-=(const Product &rhs)
+{
+    return subMul(rhs.a, rhs.b);
+}
+#endif
+
+inline BigInt BigInt::modPow(BigInt base, BigInt exp, BigInt modulus)
+{
+    if (modulus == 1) return 0;
+    if (exp <= 0) return 1;
+
+    // Same sign convention as reducing every product with %: |base|^exp mod |modulus|,
+    // negated for a negative base raised to an odd power
+    bool negate = base.sign && !exp.isEven();
+    BigInt result;
+    if (!modulus.isEven() && modulus.abs() > 1) {
+        MontgomeryContext ctx(modulus);
+        result = ctx.pow(base.abs(), exp);
+    } else {
+        base = base.abs() % modulus;
+        int window = windowBits(exp.bitLength());
+        std::vector<BigInt> table(size_t(1) << (window - 1));
+        table[0] = base;
+        if (window > 1) {
+            BigInt sq = base.square() % modulus;
+            for (size_t i = 1; i < table.size(); ++i) {
+                table[i] = mulMod(table[i - 1], sq, modulus);
+            }
+        }
+        result = 1;
+        slidingWindowPow(exp, window,
+            [&]() { result = result.square() % modulus; },
+            [&](size_t idx, bool started) {
+                result = started ? mulMod(result, table[idx], modulus) : table[idx];
+            });
+    }
+    return negate ? -result : result;
+}
+
+inline bool BigInt::millerRabinTest(BigInt d) const
+{
+    return millerRabinTest(d, MontgomeryContext(*this));
+}
+
+inline bool BigInt::millerRabinTest(const BigInt &odd_part, const MontgomeryContext &ctx) const
+{
+    return millerRabinRound(BigInt(2) + randomBelow(*this - 3), odd_part, ctx);
+}
+
+inline bool BigInt::millerRabinRound(const BigInt &a, const BigInt &odd_part, const MontgomeryContext &ctx) const
+{
+    // Everything stays in Montgomery form, 1 and n - 1 are compared in that form too
+    const BigInt &one = ctx.one();
+    BigInt minus_one = *this - one;
+    BigInt x = ctx.montPow(ctx.toMontgomery(a), odd_part);
+
+    if (x == one || x == minus_one) {
+        return true;
+    }
+
+    // n - 1 = odd_part * 2^r, x has to reach n - 1 within the squarings up to a^((n - 1) / 2)
+    size_t r = (*this - 1).bitLength() - odd_part.bitLength();
+    for (size_t i = 1; i < r; ++i) {
+        x = ctx.square(x);
+        if (x == one) return false;
+        if (x == minus_one) return true;
+    }
+
+    return false;
+}
+
+inline bool BigInt::screenPrimality(bool &prime, BigInt &odd_part) const
+{
+    prime = false;
+    if (*this <= 1) return true;
+    if (limbs.size() == 1) {
+        prime = isPrimeWord(limbs[0]);
+        return true;
+    }
+    if (this->isEven()) return true;
+
+    // Most composites have a small factor, which costs a few passes over the limbs instead
+    // of the first exponentiation. Above one limb none of them can be the value itself.
+    if (smallPrimeDivisor()) return true;
+
+    odd_part = *this - 1;
+    while (odd_part.isEven()) {
+        odd_part >>= 1;
+    }
+    return false;
+}
+
+inline bool BigInt::isPrime(int k, unsigned threads) const
+{
+    bool prime;
+    BigInt d;
+    if (screenPrimality(prime, d)) {
+        return prime;
+    }
+
+    MontgomeryContext ctx(*this);
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (threads == 1 || k <= 1) {
+        for (int i = 0; i < k; i++) {
+            if (!millerRabinTest(d, ctx)) return false;
+        }
+        return true;
+    }
+
+    // Uniform bases in [2, n - 2]
+    std::vector<BigInt> bases(k);
+    BigInt range = *this - 3;
+    for (int i = 0; i < k; i++) {
+        bases[i] = BigInt(2) + randomBelow(range);
+    }
+
+    // Workers claim rounds from a shared counter, the context is only read
+    std::atomic<int> next(0);
+    std::atomic<bool> composite(false);
+    std::exception_ptr error;
+    std::mutex error_lock;
+    auto worker = [&]() {
+        try {
+            while (!composite) {
+                int i = next++;
+                if (i >= k) {
+                    break;
+                }
+                if (!millerRabinRound(bases[i], d, ctx)) {
+                    composite = true;
+                }
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(error_lock);
+            error = std::current_exception();
+            composite = true;
+        }
+    };
+
+    // Reserved up front so that only thread creation can fail once a worker runs. If it does,
+    // the threads already started and this one share the remaining rounds.
+    std::vector<std::thread> pool;
+    pool.reserve(std::min<unsigned>(threads, k) - 1);
+    for (unsigned t = 1; t < std::min<unsigned>(threads, k); ++t) {
+        try {
+            pool.emplace_back(worker);
+        } catch (const std::system_error &) {
+            break;
+        }
+    }
+    worker();
+    for (std::thread &thread : pool) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return !composite;
+}
+
+inline int BigInt::jacobi(BigInt a, BigInt n)
+{
+    if (n <= 0 || n.isEven()) {
+        throw std::invalid_argument("Jacobi symbol needs an odd positive modulus");
+    }
+    a = a % n;
+    if (a < 0) {
+        a += n;
+    }
+
+    int result = 1;
+    while (a) {
+        // (2/n) = -1 exactly when n = 3 or 5 mod 8
+        while (a.isEven()) {
+            a >>= 1;
+            limb_t r = n.limbs[0] & 7;
+            if (r == 3 || r == 5) {
+                result = -result;
+            }
+        }
+        // Quadratic reciprocity flips the sign when both are 3 mod 4
+        std::swap(a, n);
+        if ((a.limbs[0] & 3) == 3 && (n.limbs[0] & 3) == 3) {
+            result = -result;
+        }
+        a = a % n;
+    }
+    return n == 1 ? result : 0;
+}
+
+inline BigInt BigInt::sqrt() const
+{
+    if (sign) {
+        throw std::domain_error("Square root of a negative BigInt");
+    }
+    if (!*this) {
+        return BigInt();
+    }
+
+    // Newton's iteration from above, 2^ceil(bits / 2) >= sqrt, decreases until it settles
+    BigInt x = BigInt(1) << (int)((bitLength() + 1) / 2);
+    for (;;) {
+        BigInt y = (x + *this / x) >> 1;
+        if (y >= x) {
+            return x;
+        }
+        x = std::move(y);
+    }
+}
+
+inline bool BigInt::strongLucasTest(const MontgomeryContext &ctx) const
+{
+    const BigInt &n = *this;
+
+    // Selfridge's method A, a perfect square never gives (D/n) = -1 so it is ruled out
+    // once the first few D have not
+    long long D = 5;
+    for (int tries = 0;; ++tries) {
+        int j = jacobi(BigInt(D), n);
+        if (j == -1) {
+            break;
+        }
+        if (j == 0 && BigInt(D < 0 ? -D : D) != n) {
+            return false;
+        }
+        if (tries == 8 && isPerfectSquare()) {
+            return false;
+        }
+        D = D > 0 ? -(D + 2) : -D + 2;
+    }
+    long long Q = (1 - D) / 4;
+
+    // Small multiples and halving are linear, so they act on Montgomery form directly
+    auto reduce = [&](BigInt x) {
+        x = x % n;
+        if (x < 0) {
+            x += n;
+        }
+        return x;
+    };
+    auto half = [&](BigInt x) {
+        if (!x.isEven()) {
+            x += n;
+        }
+        return x >> 1;
+    };
+    BigInt d_mont = ctx.toMontgomery(reduce(BigInt(D)));
+    BigInt q_mont = ctx.toMontgomery(reduce(BigInt(Q)));
+
+    // n + 1 = d * 2^s with d odd
+    BigInt d = n + 1;
+    int s = 0;
+    while (d.isEven()) {
+        d >>= 1;
+        ++s;
+    }
+
+    // U_k, V_k and Q^k from k = 1, doubling per bit of d and stepping k + 1 on set bits
+    BigInt U = ctx.one(), V = ctx.one(), Qk = q_mont;
+    for (size_t i = d.bitLength() - 1; i-- > 0;) {
+        U = ctx.multiply(U, V);
+        V = reduce(ctx.square(V) - (Qk << 1));
+        Qk = ctx.square(Qk);
+        if (d.testBit(i)) {
+            BigInt u = half(reduce(U + V));
+            V = half(reduce(ctx.multiply(d_mont, U) + V));
+            U = std::move(u);
+            Qk = ctx.multiply(Qk, q_mont);
+        }
+    }
+
+    if (!U || !V) {
+        return true;
+    }
+    for (int r = 1; r < s; ++r) {
+        V = reduce(ctx.square(V) - (Qk << 1));
+        if (!V) {
+            return true;
+        }
+        Qk = ctx.square(Qk);
+    }
+    return false;
+}
+
+inline bool BigInt::isProbablePrimeBPSW() const
+{
+    bool prime;
+    BigInt d;
+    if (screenPrimality(prime, d)) {
+        return prime;
+    }
+    MontgomeryContext ctx(*this);
+    return millerRabinRound(BigInt(2), d, ctx) && strongLucasTest(ctx);
 }
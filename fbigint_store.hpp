@@ -0,0 +1,228 @@
+#pragma once
+/*
+  Permissive BSD 2-Clause License - see LICENSE file for details
+  by Marko 'Fador' Viitanen 2023
+*/
+
+// Binary container for large collections of BigInts and a reader that maps the file into
+// memory, so values are used in place instead of parsed at startup. Needs POSIX mmap.
+//
+// Layout, every field a 64-bit limb-sized word in host byte order:
+//   header   magic "FBIGINT1", version (low 32 bits) and byte order mark (high 32 bits),
+//            value count, total payload limbs
+//   index    per value: limb offset into the payload, limb count with the sign in bit 63
+//   payload  the trimmed magnitude limbs of every value, least significant first
+// The payload starts at a multiple of 8 bytes, so mapped limbs are properly aligned.
+
+#include "fbigint.hpp"
+
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only value made of borrowed limbs, valid as long as the storage it points into
+class BigIntView
+{
+public:
+  BigIntView() : ptr(nullptr), len(0), negative(false) {}
+
+  BigIntView(const BigInt::limb_t *data, size_t size, bool is_negative)
+    : ptr(data), len(size), negative(is_negative && size > 0) {}
+
+  explicit BigIntView(const BigInt &value)
+    : ptr(value.limbData()), len(value.limbCount()), negative(value < 0) {}
+
+  const BigInt::limb_t *limbData() const { return ptr; }
+  size_t limbCount() const { return len; }
+  bool isNegative() const { return negative; }
+
+  // Owning copy of the value, one copy of the limbs
+  BigInt value() const
+  {
+    BigInt result = BigInt::importBytes(ptr, len * sizeof(BigInt::limb_t), sizeof(BigInt::limb_t),
+                                        BigInt::Endian::little, BigInt::Endian::native);
+    return negative ? -std::move(result) : result;
+  }
+
+  std::string toString(int base = 10) const
+  {
+    return value().toString(base);
+  }
+
+  friend bool operator==(const BigIntView &lhs, const BigIntView &rhs)
+  {
+    return lhs.negative == rhs.negative && lhs.len == rhs.len &&
+           (lhs.len == 0 || std::memcmp(lhs.ptr, rhs.ptr, lhs.len * sizeof(BigInt::limb_t)) == 0);
+  }
+
+  friend bool operator!=(const BigIntView &lhs, const BigIntView &rhs)
+  {
+    return !(lhs == rhs);
+  }
+
+  friend bool operator==(const BigIntView &lhs, const BigInt &rhs) { return lhs == BigIntView(rhs); }
+  friend bool operator==(const BigInt &lhs, const BigIntView &rhs) { return BigIntView(lhs) == rhs; }
+  friend bool operator!=(const BigIntView &lhs, const BigInt &rhs) { return !(lhs == rhs); }
+  friend bool operator!=(const BigInt &lhs, const BigIntView &rhs) { return !(lhs == rhs); }
+
+private:
+  const BigInt::limb_t *ptr;
+  size_t len;
+  bool negative;
+};
+
+class BigIntStore
+{
+public:
+  typedef BigInt::limb_t limb_t;
+
+  // Writes values to path in the container layout, throws std::runtime_error on I/O errors
+  static void write(const std::string &path, const BigInt *values, size_t count)
+  {
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot create BigInt store " + path);
+    }
+
+    uint64_t payload = 0;
+    for (size_t i = 0; i < count; ++i) {
+        payload += values[i].limbCount();
+    }
+    uint64_t header[HEADER_WORDS] = {MAGIC, VERSION_WORD, count, payload};
+    out.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+    uint64_t offset = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t entry[2] = {offset, values[i].limbCount() | (values[i] < 0 ? SIGN_BIT : 0)};
+        out.write(reinterpret_cast<const char *>(entry), sizeof(entry));
+        offset += values[i].limbCount();
+    }
+    for (size_t i = 0; i < count; ++i) {
+        out.write(reinterpret_cast<const char *>(values[i].limbData()),
+                  values[i].limbCount() * sizeof(limb_t));
+    }
+
+    if (!out.flush()) {
+        throw std::runtime_error("Cannot write BigInt store " + path);
+    }
+  }
+
+  static void write(const std::string &path, const std::vector<BigInt> &values)
+  {
+    write(path, values.data(), values.size());
+  }
+
+  // Maps path read-only and checks the header and that the index and payload fit in the
+  // file. Entries themselves are only checked by at(), so opening touches a few pages.
+  explicit BigIntStore(const std::string &path) : base(nullptr), mapped(0), count(0)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open BigInt store " + path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(uint64_t) * HEADER_WORDS) {
+        ::close(fd);
+        throw std::runtime_error("Not a BigInt store " + path);
+    }
+    mapped = size_t(info.st_size);
+    void *map = ::mmap(nullptr, mapped, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Cannot map BigInt store " + path);
+    }
+    base = static_cast<const uint64_t *>(map);
+
+    // Checked without forming HEADER_WORDS + 2 * count + payload, which a corrupt header can
+    // make wrap around to the file size
+    uint64_t entries = base[2], payload = base[3];
+    uint64_t words = mapped / sizeof(uint64_t);
+    if (base[0] != MAGIC || base[1] != VERSION_WORD || mapped % sizeof(uint64_t) != 0 ||
+        entries > (words - HEADER_WORDS) / 2 || payload != words - HEADER_WORDS - 2 * entries) {
+        unmap();
+        throw std::runtime_error("Not a BigInt store or written with another byte order " + path);
+    }
+    count = size_t(entries);
+  }
+
+  BigIntStore(const BigIntStore &) = delete;
+  BigIntStore &operator=(const BigIntStore &) = delete;
+
+  BigIntStore(BigIntStore &&other) noexcept : base(other.base), mapped(other.mapped), count(other.count)
+  {
+    other.base = nullptr;
+    other.mapped = 0;
+    other.count = 0;
+  }
+
+  BigIntStore &operator=(BigIntStore &&other) noexcept
+  {
+    if (this != &other) {
+        unmap();
+        std::swap(base, other.base);
+        std::swap(mapped, other.mapped);
+        std::swap(count, other.count);
+    }
+    return *this;
+  }
+
+  ~BigIntStore()
+  {
+    unmap();
+  }
+
+  size_t size() const { return count; }
+
+  // View of value i pointing into the mapping, valid while the store is open. Not range
+  // checked, like std::vector.
+  BigIntView operator[](size_t i) const
+  {
+    const uint64_t *entry = base + HEADER_WORDS + 2 * i;
+    return BigIntView(reinterpret_cast<const limb_t *>(payload()) + entry[0],
+                      size_t(entry[1] & ~SIGN_BIT), (entry[1] & SIGN_BIT) != 0);
+  }
+
+  // Checked operator[], throws std::out_of_range for a bad index or an entry outside the mapped
+  // payload
+  BigIntView at(size_t i) const
+  {
+    if (i >= count) {
+        throw std::out_of_range("BigIntStore index out of range");
+    }
+    const uint64_t *entry = base + HEADER_WORDS + 2 * i;
+    uint64_t length = entry[1] & ~SIGN_BIT;
+    uint64_t payload_limbs = mapped / sizeof(uint64_t) - HEADER_WORDS - 2 * count;
+    if (entry[0] > payload_limbs || length > payload_limbs - entry[0] ||
+        (length > 0 && payload()[entry[0] + length - 1] == 0)) {
+        throw std::out_of_range("BigIntStore entry outside the payload or not trimmed");
+    }
+    return (*this)[i];
+  }
+
+private:
+  // "FBIGINT1" read as a little-endian word
+  static const uint64_t MAGIC = 0x31544e4947494246ULL;
+  // Version 1 and a byte order mark that reads differently on a host of the other order
+  static const uint64_t VERSION_WORD = 0x0102030400000001ULL;
+  static const uint64_t SIGN_BIT = uint64_t(1) << 63;
+  enum { HEADER_WORDS = 4 };
+
+  const uint64_t *payload() const
+  {
+    return base + HEADER_WORDS + 2 * count;
+  }
+
+  void unmap()
+  {
+    if (base) {
+        ::munmap(const_cast<uint64_t *>(base), mapped);
+        base = nullptr;
+    }
+  }
+
+  const uint64_t *base;
+  size_t mapped;
+  size_t count;
+};
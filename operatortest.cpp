@@ -1,6 +1,22 @@
 #include "fbigint.hpp"
+#include "fbigint_store.hpp"
 #include <cassert>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <sstream>
+
+// Writes bytes as operatortest_store.bin and reports whether opening it as a store throws
+bool storeRejects(const std::string &bytes) {
+    std::ofstream("operatortest_store.bin", std::ios::binary | std::ios::trunc).write(bytes.data(), bytes.size());
+    try {
+        BigIntStore store("operatortest_store.bin");
+    } catch (const std::runtime_error &) {
+        return true;
+    }
+    return false;
+}
 
 void operator_tests() {
     std::cout << "Running operator tests..." << std::endl;
@@ -15,6 +31,125 @@ void operator_tests() {
     BigInt neg_long_long_constructor(-1234567890123456789LL);
     assert(neg_long_long_constructor == BigInt("-1234567890123456789"));
 
+    // BigInt(const std::string &) and BigInt(const char *, size_t)
+    assert(BigInt("+42") == 42);
+    assert(BigInt("-0") == 0);
+    assert(BigInt("") == 0);
+    assert(BigInt("000123") == 123);
+    assert(BigInt("12345678901234567890", 5) == 12345);
+    std::string ten_400 = "1" + std::string(400, '0'); // past the Horner range, merged with the power table
+    assert(BigInt(ten_400) == BigInt(10).pow(400));
+    assert(BigInt("-" + ten_400 + "7") == -(BigInt(10).pow(401) + 7));
+
+    // toString
+    assert(BigInt(0).toString() == "0");
+    assert(BigInt(-7).toString() == "-7");
+    assert(BigInt(ten_400).toString() == ten_400);
+    assert((-BigInt(ten_400)).toString() == "-" + ten_400);
+    std::string digits_50000; // deep enough for the split by powers of ten
+    for (int i = 0; i < 50000; ++i) {
+        digits_50000 += char('1' + i % 9);
+    }
+    assert(BigInt(digits_50000).toString() == digits_50000);
+    bool parse_threw = false;
+    try {
+        BigInt parse_bad("12x4");
+    } catch (const std::invalid_argument &) {
+        parse_threw = true;
+    }
+    assert(parse_threw);
+    (void)parse_threw;
+
+    // toString(int base), fromString and stream base flags
+    BigInt radix_x = BigInt(ten_400) + 12345;
+    for (int base = 2; base <= 36; ++base) {
+        assert(BigInt::fromString(radix_x.toString(base), base) == radix_x);
+        assert(BigInt::fromString((-radix_x).toString(base), base) == -radix_x);
+    }
+    assert(BigInt(255).toString(16) == "ff");
+    assert(BigInt(-5).toString(2) == "-101");
+    assert(BigInt(35).toString(36) == "z");
+    assert(BigInt::fromString("-FfFf", 16) == -65535);
+    assert(BigInt::fromString("777", 8) == 511);
+    assert(BigInt::fromString("1" + std::string(130, '0'), 2) == BigInt(1) << 130); // digits straddling limbs
+    std::ostringstream radix_stream;
+    radix_stream << std::hex << BigInt(255) << " " << std::showbase << std::uppercase << BigInt(-255) << " "
+                 << std::oct << std::noshowbase << BigInt(8) << " " << std::dec << BigInt(10);
+    assert(radix_stream.str() == "ff -0XFF 10 10");
+    bool base_threw = false, digit_threw = false;
+    try {
+        radix_x.toString(37);
+    } catch (const std::invalid_argument &) {
+        base_threw = true;
+    }
+    try {
+        BigInt::fromString("102", 2);
+    } catch (const std::invalid_argument &) {
+        digit_threw = true;
+    }
+    assert(base_threw);
+    assert(digit_threw);
+    (void)base_threw;
+    (void)digit_threw;
+
+    // exportBytes, importBytes and the limb view
+    BigInt bytes_x = BigInt::fromString("1234567890abcdef1122334455", 16);
+    unsigned char bytes_buf[32];
+    assert(bytes_x.exportBytes(bytes_buf, sizeof(bytes_buf)) == 13);
+    assert(bytes_buf[0] == 0x12);
+    assert(bytes_buf[12] == 0x55);
+    assert(BigInt::importBytes(bytes_buf, 13) == bytes_x);
+    // 4-byte words, least significant word first, bytes big-endian inside each word
+    assert(bytes_x.exportBytes(bytes_buf, sizeof(bytes_buf), 4, BigInt::Endian::little) == 16);
+    assert(bytes_buf[0] == 0x22);
+    assert(bytes_buf[3] == 0x55);
+    assert(bytes_buf[12] == 0);
+    assert(bytes_buf[15] == 0x12);
+    assert(BigInt::importBytes(bytes_buf, 16, 4, BigInt::Endian::little) == bytes_x);
+    size_t native_size = bytes_x.exportBytes(bytes_buf, sizeof(bytes_buf), 8, BigInt::Endian::little, BigInt::Endian::native);
+    assert(native_size == 16);
+    assert(std::memcmp(bytes_buf, bytes_x.limbData(), native_size) == 0);
+    (void)native_size;
+    assert(BigInt::importBytes(bytes_buf, 16, 8, BigInt::Endian::little, BigInt::Endian::native) == bytes_x);
+    assert(bytes_x.limbCount() == 2);
+    assert(bytes_x.limbData()[1] == 0x1234567890);
+    assert(BigInt(0).exportSize(8) == 0);
+    assert(BigInt::importBytes(bytes_buf, 0) == 0);
+    assert((-bytes_x).exportSize() == 13);
+    bool bytes_threw = false;
+    try {
+        bytes_x.exportBytes(bytes_buf, 12);
+    } catch (const std::length_error &) {
+        bytes_threw = true;
+    }
+    assert(bytes_threw);
+    (void)bytes_threw;
+
+    // BigIntStore, values read back in place from the mapped file
+    std::vector<BigInt> store_values = {bytes_x, BigInt(0), -radix_x, BigInt(1) << 200};
+    BigIntStore::write("operatortest_store.bin", store_values);
+    {
+        BigIntStore store("operatortest_store.bin");
+        assert(store.size() == store_values.size());
+        for (size_t i = 0; i < store.size(); ++i) {
+            assert(store.at(i) == store_values[i]);
+            assert(store[i].value() == store_values[i]);
+        }
+        assert(store[2].isNegative());
+        assert(store[1].limbCount() == 0);
+        assert(store[3].toString(16) == "1" + std::string(50, '0'));
+    }
+    // Truncated files and headers whose sizes only add up after wrapping around are rejected
+    std::ifstream store_in("operatortest_store.bin", std::ios::binary);
+    std::string store_bytes((std::istreambuf_iterator<char>(store_in)), std::istreambuf_iterator<char>());
+    store_in.close();
+    assert(storeRejects(store_bytes.substr(0, store_bytes.size() - 8)));
+    std::string store_corrupt = store_bytes.substr(0, 32);
+    uint64_t corrupt_sizes[2] = {3, ~uint64_t(0) - 5}; // 4 + 2 * 3 + 2^64 - 6 wraps to 4 words
+    std::memcpy(&store_corrupt[16], corrupt_sizes, sizeof(corrupt_sizes));
+    assert(storeRejects(store_corrupt));
+    std::remove("operatortest_store.bin");
+
     // operator=(const BigInt &rhs)
     BigInt assign_op;
     BigInt val_to_assign("987654321");
@@ -113,6 +248,7 @@ void operator_tests() {
     BigInt pow_base("2");
     assert(pow_base.pow(10) == BigInt("1024"));
     assert(pow_base.pow(0) == BigInt("1"));
+    assert(BigInt("3").pow(100) == BigInt("515377520732011331036461129765621272702107522001"));
 
     // abs()
     BigInt abs_val("-123");
@@ -133,12 +269,131 @@ void operator_tests() {
     // modPow()
     BigInt mod_base("3"), mod_exp("4"), mod_mod("5");
     assert(BigInt::modPow(mod_base, mod_exp, mod_mod) == BigInt("1")); // 3^4 % 5 = 81 % 5 = 1
+    assert(BigInt::modPow(BigInt("-2"), BigInt("3"), mod_mod) == BigInt("-3")); // -(8 % 5)
+    assert(BigInt::modPow(mod_base, mod_exp, BigInt("6")) == BigInt("3")); // even modulus, 81 % 6 = 3
+
+    // MontgomeryContext
+    BigInt mont_mod("340282366920938463463374607431768211507"); // 2^128 + 51, prime
+    MontgomeryContext mont(mont_mod);
+    BigInt mont_a("123456789012345678901234567890"), mont_b("987654321098765432109876543210");
+    assert(mont.fromMontgomery(mont.toMontgomery(mont_a)) == mont_a);
+    assert(mont.fromMontgomery(mont.multiply(mont.toMontgomery(mont_a), mont.toMontgomery(mont_b))) == (mont_a * mont_b) % mont_mod);
+    assert(mont.pow(mont_a, mont_mod - 1) == 1); // Fermat
+    MontgomeryContext::PowTable mont_table = mont.precompute(mont.toMontgomery(mont_a), 4);
+    assert(mont.fromMontgomery(mont.montPow(mont_table, mont_b)) == BigInt::modPow(mont_a, mont_b, mont_mod));
+    assert(mont.fromMontgomery(mont.montPow(mont_table, BigInt(0))) == 1);
+    assert(mont.square(mont.toMontgomery(mont_a)) == mont.multiply(mont.toMontgomery(mont_a), mont.toMontgomery(mont_a)));
+
+    // BarrettReducer
+    BigInt barrett_mod("1000000000000000000000000000000"); // even, so Montgomery does not apply
+    BarrettReducer barrett(barrett_mod);
+    BigInt barrett_x("123456789012345678901234567890123456789012345678901234567890");
+    assert(barrett.reduce(barrett_x) == barrett_x.divmod(barrett_mod).second);
+    assert(barrett.reduce(-barrett_x) == -(barrett_x.divmod(barrett_mod).second));
+    assert(barrett.divmod(-barrett_x) == (-barrett_x).divmod(barrett_mod));
+    assert(barrett.multiply(barrett_x, barrett_x) == barrett_x.multiply(barrett_x).divmod(barrett_mod).second);
+    for (int i = 0; i < 3; ++i) { // repeated reductions by the same divisor
+        assert(barrett_x % barrett_mod == BigInt("123456789012345678901234567890"));
+    }
+    // Divisors of at least 1024 limbs are cached by operator% and reduced with Barrett from
+    // their second use on, for dividends of either sign
+    BigInt cached_mod = (BigInt(1) << 70000) + BigInt::generateRandom(60000);
+    BigInt cached_x = BigInt::generateRandom(130000), cached_y = -BigInt::generateRandom(120000);
+    BigInt cached_rx = cached_x.divmod(cached_mod).second, cached_ry = cached_y.divmod(cached_mod).second;
+    for (int i = 0; i < 3; ++i) {
+        assert(cached_x % cached_mod == cached_rx);
+        assert(cached_y % cached_mod == cached_ry);
+    }
+    assert(cached_ry < 0);
+    assert(cached_x % (cached_mod + 1) == cached_x.divmod(cached_mod + 1).second);
 
     // isPrime()
     BigInt prime("17");
     BigInt not_prime("18");
     assert(prime.isPrime());
     assert(!not_prime.isPrime());
+    BigInt mersenne_2203 = (BigInt(1) << 2203) - 1;
+    assert(BigInt(5).isPrime());
+    assert(BigInt(997).isPrime());
+    assert(!BigInt(991 * 997).isPrime());
+    assert(BigInt(1009).isPrime());
+    BigInt mersenne_521 = (BigInt(1) << 521) - 1;
+    assert(mersenne_521.isPrime());
+    assert(!(mersenne_521 * 997).isPrime()); // rejected by trial division
+    // generateRandom and randomBelow, with the default engine or a caller's generator
+    std::mt19937 seeded_a(42), seeded_b(42);
+    BigInt random_a = BigInt::generateRandom(300, seeded_a);
+    assert(random_a == BigInt::generateRandom(300, seeded_b));
+    assert(random_a.bitLength() == 300);
+    assert(BigInt::generateRandom(1) == 1);
+    assert(BigInt::generateRandom(64).bitLength() == 64);
+    bool below_seen[5] = {false, false, false, false, false};
+    for (int i = 0; i < 200; ++i) {
+        BigInt r = BigInt::randomBelow(5);
+        assert(r >= 0 && r < 5);
+        below_seen[r.limbCount() ? r.limbData()[0] : 0] = true;
+    }
+    assert(below_seen[0]);
+    assert(below_seen[4]);
+    (void)below_seen;
+    BigInt below_big = (BigInt(1) << 200) + 1;
+    assert(BigInt::randomBelow(below_big, seeded_a) < below_big);
+    std::mt19937_64 prime_seed_a(7), prime_seed_b(7);
+    BigInt seeded_prime = BigInt::generatePrime(160, prime_seed_a);
+    assert(seeded_prime == BigInt::generatePrime(160, prime_seed_b, BigInt::PrimalityTest::bailliePSW));
+    assert(seeded_prime.bitLength() == 160);
+    assert(seeded_prime.isPrime());
+
+    // Single-word fast paths
+    BigInt word_max = BigInt::fromString("ffffffffffffffff", 16);
+    // Arithmetic across the 64-bit boundary
+    assert(word_max + 1 == BigInt(1) << 64);
+    assert(word_max * word_max == (BigInt(1) << 128) - (BigInt(1) << 65) + 1);
+    assert(BigInt(5) - word_max == -(word_max - 5));
+    assert(word_max.square() == word_max * word_max);
+    // Division and remainder by a word
+    assert(BigInt(-7) / 2 == -3);
+    assert(BigInt(-7) % 2 == -1);
+    assert(word_max / word_max == 1);
+    assert(word_max % 10 == 5);
+    // Comparison with a small value
+    assert(BigInt(-3) < 2);
+    assert(BigInt(-3) < BigInt(-2));
+    assert(!(word_max < 5));
+    assert(BigInt(0) <= 0);
+    assert(BigInt(-1) >= -1);
+    // Deterministic primality below 2^64, 3215031751 is a strong pseudoprime to bases 2, 3, 5 and 7
+    assert(BigInt("18446744073709551557").isPrime());
+    assert(!BigInt("18446744073709551559").isPrime());
+    assert(!BigInt("3215031751").isPrime());
+
+    // Baillie-PSW and its helpers, first the Jacobi symbol
+    assert(BigInt::jacobi(1001, 9907) == -1);
+    assert(BigInt::jacobi(19, 45) == 1);
+    assert(BigInt::jacobi(-7, 15) == 1);
+    assert(BigInt::jacobi(7, 15) == -1);
+    assert(BigInt::jacobi(6, 9) == 0);
+    // Integer square root and perfect squares
+    assert(BigInt(10).pow(40).sqrt() == BigInt(10).pow(20));
+    assert((BigInt(10).pow(40) - 1).sqrt() == BigInt(10).pow(20) - 1);
+    assert(BigInt(1194649).isPerfectSquare());
+    assert(!BigInt(1194648).isPerfectSquare());
+    // Baillie-PSW on a Mersenne prime, directly and through isPrime
+    assert(mersenne_521.isProbablePrimeBPSW());
+    assert(mersenne_521.isPrime(BigInt::PrimalityTest::bailliePSW));
+    // Strong pseudoprimes to base 2 without a factor below 1000, the second one a square
+    assert(!BigInt("3825123056546413051").isProbablePrimeBPSW());
+    assert(!BigInt(1194649).isProbablePrimeBPSW());
+    assert(BigInt::generatePrime(256, BigInt::PrimalityTest::bailliePSW).isPrime());
+    BigInt sieved_prime = BigInt::generatePrime(200), small_prime = BigInt::generatePrime(20);
+    assert(sieved_prime.isPrime());
+    assert(sieved_prime.bitLength() >= 200);
+    assert(small_prime.isPrime());
+    assert(sieved_prime % 3 != 0);
+    assert(sieved_prime % 32749 != 0);
+    assert(mersenne_2203.isPrime(8, 4));
+    assert(!(mersenne_2203 * 3).isPrime(8, 4));
+    assert(prime.isPrime(20, 0));
 
     // BigInt + BigInt
     assert(BigInt("100") + BigInt("50") == BigInt("150"));
@@ -146,11 +401,100 @@ void operator_tests() {
     assert(BigInt("100") - BigInt("50") == BigInt("50"));
     // BigInt * BigInt
     assert(BigInt("10") * BigInt("12") == BigInt("120"));
+    // Multiplication tiers agree with each other
+    BigInt big_a = BigInt::generateRandom(30000), big_b = -BigInt::generateRandom(29000);
+    BigInt toom_product = big_a * big_b;
+    assert(toom_product == -big_a.karatsubaMultiply(big_b));
+    assert(toom_product == -big_a.toom3Multiply(big_b));
+    assert(toom_product == -big_a.nttMultiply(big_b));
+    assert(big_a.nttMultiply(big_a) == big_a.toom3Multiply(big_a));
+    assert(toom_product / big_b == big_a);
+    // Unbalanced Toom-sized operands go block by block, zero blocks included
+    size_t toom3_default = BigInt::toom3Threshold();
+    BigInt::toom3Threshold() = 96;
+    BigInt long_a = (BigInt(1) << 200000) + BigInt::generateRandom(130000);
+    BigInt short_b = BigInt::generateRandom(6500);
+    assert(long_a * short_b == long_a.karatsubaMultiply(short_b));
+    assert(short_b * -long_a == -long_a.karatsubaMultiply(short_b));
+    BigInt::toom3Threshold() = toom3_default;
+    // Squaring variants against the general products of a distinct copy
+    BigInt big_b_copy = big_b;
+    assert(big_b.square() == big_b * big_b_copy);
+    assert(big_b.karatsubaMultiply(big_b) == big_b.karatsubaMultiply(big_b_copy));
+    assert(big_b.toom3Multiply(big_b) == big_b.toom3Multiply(big_b_copy));
+    assert(BigInt(-7).square() == 49);
+    assert(BigInt(0).square() == 0);
+    // Threaded subproducts, forced down to small sizes, match the serial results bit for bit
+    BigInt::multiplyThreads() = 4;
+    BigInt::parallelMultiplyThreshold() = 64;
+    assert(big_a.karatsubaMultiply(big_b) == -toom_product);
+    assert(big_a.toom3Multiply(big_b) == -toom_product);
+    assert(big_a.nttMultiply(big_b) == -toom_product);
+    assert(big_b.karatsubaMultiply(big_b) == big_b * big_b_copy);
+    assert(big_b.toom3Multiply(big_b) == big_b * big_b_copy);
+    BigInt::multiplyThreads() = 1;
+    BigInt::parallelMultiplyThreshold() = 1536;
     // BigInt / BigInt
     assert(BigInt("100") / BigInt("4") == BigInt("25"));
     // BigInt % BigInt
     assert(BigInt("10") % BigInt("3") == BigInt("1"));
 
+    // Move construction and assignment leave the source as zero
+    BigInt move_src = BigInt(1) << 1000;
+    BigInt move_dst = std::move(move_src);
+    assert(move_dst == BigInt(1) << 1000);
+    assert(move_src == 0);
+    move_src = -move_dst;
+    move_dst = std::move(move_src);
+    assert(move_dst == -(BigInt(1) << 1000));
+    assert(move_src == 0);
+    // Moves are noexcept, so a growing vector moves its values instead of copying them
+    std::vector<BigInt> grown;
+    unsigned long long grown_before = BigInt::allocationCount();
+    for (int i = 0; i < 16; ++i) {
+        grown.push_back(BigInt(1) << (1000 + i));
+    }
+    assert(BigInt::allocationCount() - grown_before == 16);
+    (void)grown_before;
+
+    // Expiring operands are reused, a * b + c - d allocates only for the product
+    BigInt chain_a = (BigInt(1) << 1200) - 1, chain_b = (BigInt(1) << 1100) + 3;
+    BigInt chain_c = (BigInt(1) << 1000) + 7, chain_d = BigInt(1) << 900;
+    unsigned long long chain_before = BigInt::allocationCount();
+    BigInt chain = chain_a * chain_b + chain_c - chain_d;
+    assert(BigInt::allocationCount() - chain_before == 1);
+    (void)chain_before;
+    // divmod moves its quotient and remainder out instead of copying them
+    BigInt div_a = BigInt::generateRandom(40 * 64), div_b = BigInt::generateRandom(20 * 64);
+    unsigned long long div_before = BigInt::allocationCount();
+    BigInt div_r = div_a % div_b;
+    assert(BigInt::allocationCount() - div_before <= 4);
+    (void)div_before;
+    BigInt chain_expected = chain_a * chain_b;
+    chain_expected += chain_c;
+    chain_expected -= chain_d;
+    assert(chain == chain_expected);
+    assert(BigInt(5) - BigInt(8) == -3);
+    assert(BigInt(5) - (chain_d + 1) == -chain_d + 4);
+    assert(-(chain_d - chain_d) == 0);
+    assert(-BigInt(7) + 2 == -5);
+
+    // Fused multiply-add, multiply-subtract and multiply-mod
+    BigInt fused = chain_c;
+    fused.addMul(chain_a, -chain_b);
+    assert(fused == chain_c - chain_a * chain_b);
+    fused.subMul(chain_a, -chain_b);
+    assert(fused == chain_c);
+    fused.subMul(chain_d, chain_d); // crosses zero
+    assert(fused == chain_c - chain_d * chain_d);
+    BigInt fused_zero;
+    fused_zero.subMul(BigInt(3), BigInt(4));
+    assert(fused_zero == -12);
+    assert(BigInt::mulMod(chain_a, chain_b, chain_c) == (chain_a * chain_b) % chain_c);
+    assert(BigInt::mulMod(-chain_a, chain_a, chain_d + 1) == (-chain_a * chain_a) % (chain_d + 1));
+    assert(BigInt::mulMod(big_a, big_b, chain_c) == toom_product % chain_c);
+    assert(BigInt::modInverse(BigInt(3), BigInt(11)) == 4);
+
     // +=
     BigInt add_assign("100");
     add_assign += BigInt("50");
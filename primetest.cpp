@@ -61,6 +61,15 @@ bool tests() {
       assert(a == b * q + r);
     }
 
+    // Test operator / with operands large enough for recursive division
+    for (int i = 0; i < 3; ++i) {
+      BigInt a = BigInt::generateRandom(40000 + 1000 * i);
+      BigInt b = BigInt::generateRandom(15000 + 500 * i);
+      auto qr = a.divmod(b);
+      assert(a == b * qr.first + qr.second);
+      assert(qr.second >= 0 && qr.second < b);
+    }
+
     // Test operator / with zero dividend
     BigInt zero(0);
     BigInt nonZero = BigInt::generateRandom(10);
@@ -235,5 +244,7 @@ int main() {
   std::cout << "Encrypted Message: " << encryptedMessage << std::endl;
   std::cout << "Decrypted Message: " << decryptedMessage << std::endl;
 
+  std::cout << "Limb heap allocations: " << BigInt::allocationCount() << std::endl;
+
   return 0;
 }